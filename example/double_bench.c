@@ -0,0 +1,188 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "../jsmn.h"
+
+/*
+ * Throughput benchmark for jsmn_dom_get_double() and jsmn_dom_new_double(): builds a
+ * float-heavy array (prices, coordinates and full precision round trips), times reading
+ * every number, one by one and with jsmn_dom_get_doubles(), against strtod() and
+ * sscanf(), checking that they all agree, then times writing them back against
+ * snprintf() and reports the output size.
+ *
+ * Usage: double_bench [numbers]
+ */
+
+static double now(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static unsigned long long next(unsigned long long *s) {
+	*s ^= *s << 13;
+	*s ^= *s >> 7;
+	*s ^= *s << 17;
+	return *s;
+}
+
+static char *gen(unsigned long count, size_t *len) {
+	char *js = malloc(count * 32 + 16);
+	unsigned long long s = 0x9E3779B97F4A7C15ULL;
+	unsigned long long r;
+	unsigned long i;
+	size_t n = 0;
+	union {
+		double value;
+		unsigned long long bits;
+	} u;
+
+	if (js == NULL) {
+		return NULL;
+	}
+	n += sprintf(js + n, "[");
+	for (i = 0; i < count; i++) {
+		r = next(&s);
+		if (i > 0) {
+			n += sprintf(js + n, ",");
+		}
+		switch (i % 3) {
+		case 0: /* price */
+			n += sprintf(js + n, "%lu.%02lu", (unsigned long) (r % 100000), (unsigned long) (r >> 32) % 100);
+			break;
+		case 1: /* coordinate */
+			n += sprintf(js + n, "%.7f", (double) (long long) (r % 3600000000ULL - 1800000000LL) / 1e7);
+			break;
+		default: /* round trip */
+			do {
+				u.bits = next(&s);
+			} while ((u.bits >> 52 & 0x7FF) == 0x7FF);
+			n += sprintf(js + n, "%.17g", u.value);
+			break;
+		}
+	}
+	n += sprintf(js + n, "]");
+	*len = n;
+	return js;
+}
+
+int main(int argc, char *argv[]) {
+	unsigned long count = argc > 1 ? strtoul(argv[1], NULL, 10) : 1000000;
+	size_t len;
+	char *js;
+	jsmntok_t *t;
+	jsmnint_t num_tokens;
+	jsmnint_t i;
+	jsmnint_t r;
+	jsmn_parser p;
+	double *ours;
+	double *libc;
+	double sec;
+	double sum;
+	char buf[64];
+	char out[64];
+	jsmntok_t tok[1];
+	jsmn_parser q;
+	unsigned long bytes;
+	int precision;
+
+	js = gen(count, &len);
+	t = malloc(sizeof(*t) * (count + 1));
+	ours = malloc(sizeof(*ours) * (count + 1));
+	libc = malloc(sizeof(*libc) * (count + 1));
+	if (js == NULL || t == NULL || ours == NULL || libc == NULL) {
+		fprintf(stderr, "out of memory\n");
+		return 1;
+	}
+	jsmn_init(&p);
+	num_tokens = jsmn_parse(&p, js, len, t, count + 1);
+	if (num_tokens != (jsmnint_t) count + 1) {
+		fprintf(stderr, "jsmn_parse() = %ld\n", (long) num_tokens);
+		return 1;
+	}
+	printf("%lu numbers, %lu bytes\n", count, (unsigned long) len);
+
+	memset(ours, 0, sizeof(*ours) * (count + 1));
+	sec = now();
+	for (i = 1; i < num_tokens; i++) {
+		jsmn_dom_get_double(&p, js, len, t, num_tokens, i, &ours[i]);
+	}
+	sec = now() - sec;
+	printf("jsmn_dom_get_double %8.1f ms %8.1f Mnum/s\n", sec * 1e3, count / sec / 1e6);
+
+	memset(libc, 0, sizeof(*libc) * (count + 1));
+	sec = now();
+	r = jsmn_dom_get_doubles(&p, js, len, t, num_tokens, 0, libc + 1, count, NULL);
+	sec = now() - sec;
+	if (r != (jsmnint_t) count || memcmp(libc + 1, ours + 1, sizeof(double) * count) != 0) {
+		fprintf(stderr, "jsmn_dom_get_doubles() disagrees\n");
+		return 1;
+	}
+	printf("jsmn_dom_get_doubles%8.1f ms %8.1f Mnum/s\n", sec * 1e3, count / sec / 1e6);
+
+	sec = now();
+	for (i = 1; i < num_tokens; i++) {
+		libc[i] = strtod(js + t[i].start, NULL);
+	}
+	sec = now() - sec;
+	printf("strtod              %8.1f ms %8.1f Mnum/s\n", sec * 1e3, count / sec / 1e6);
+	for (i = 1; i < num_tokens; i++) {
+		if (memcmp(&ours[i], &libc[i], sizeof(double)) != 0) {
+			fprintf(stderr, "mismatch: %.*s\n", (int) (t[i].end - t[i].start), js + t[i].start);
+			return 1;
+		}
+	}
+
+	/* sscanf() measures the rest of its input first, so give it one number at a time */
+	sec = now();
+	for (i = 1; i < num_tokens; i++) {
+		memcpy(buf, js + t[i].start, t[i].end - t[i].start);
+		buf[t[i].end - t[i].start] = '\0';
+		sscanf(buf, "%lf", &libc[i]);
+	}
+	sec = now() - sec;
+	printf("sscanf              %8.1f ms %8.1f Mnum/s\n", sec * 1e3, count / sec / 1e6);
+
+	bytes = 0;
+	sec = now();
+	for (i = 1; i < num_tokens; i++) {
+		jsmn_init(&q);
+		jsmn_dom_new_double(&q, out, sizeof(out), tok, 1, ours[i]);
+		bytes += tok[0].end - tok[0].start;
+	}
+	sec = now() - sec;
+	printf("jsmn_dom_new_double %8.1f ms %8.1f Mnum/s %10lu bytes\n", sec * 1e3, count / sec / 1e6, bytes);
+	for (i = 1; i < num_tokens; i++) {
+		jsmn_init(&q);
+		jsmn_dom_new_double(&q, out, sizeof(out), tok, 1, ours[i]);
+		if (strtod(out + tok[0].start, NULL) != ours[i]) {
+			fprintf(stderr, "no round trip: %.*s\n", (int) (tok[0].end - tok[0].start), out + tok[0].start);
+			return 1;
+		}
+	}
+
+	for (precision = 16; precision <= 17; precision++) {
+		bytes = 0;
+		sec = now();
+		for (i = 1; i < num_tokens; i++) {
+			jsmn_init(&q);
+			snprintf(buf, sizeof(buf), "%.*g ", precision, ours[i]);
+			jsmn_dom_new_primitive(&q, out, sizeof(out), tok, 1, buf);
+			bytes += tok[0].end - tok[0].start;
+		}
+		sec = now() - sec;
+		printf("snprintf %%.%dg      %8.1f ms %8.1f Mnum/s %10lu bytes\n", precision, sec * 1e3, count / sec / 1e6, bytes);
+	}
+
+	sum = 0;
+	for (i = 1; i < num_tokens; i++) {
+		sum += libc[i] - ours[i];
+	}
+
+	free(libc);
+	free(ours);
+	free(t);
+	free(js);
+	return sum != 0;
+}
@@ -20,6 +20,15 @@ static inline void *realloc_it(void *ptrmem, size_t size) {
 	return p;
 }
 
+/* Function realloc_tokens() is the token allocator given to jsmn_parse_ex().
+ * Unlike realloc_it(), it leaves the old tokens allocated on failure, as
+ * jsmn_parse_ex() still hands them back to the caller.
+ */
+static void *realloc_tokens(void *ctx, void *ptr, size_t size) {
+	(void) ctx;
+	return realloc(ptr, size);
+}
+
 /*
  * An example of reading JSON from stdin and printing its content to stdout.
  * The output looks like YAML, but I'm not sure if it's really compatible.
@@ -31,15 +40,15 @@ static int dump(const char *js, jsmntok_t *t, size_t count, int indent) {
 		return 0;
 	}
 	if (t->type == JSMN_PRIMITIVE) {
-		printf("%.*s", t->end - t->start, js+t->start);
+		printf("%.*s", (int) JSMN_TOK_LEN(t), js+JSMN_TOK_START(t));
 		return 1;
 	} else if (t->type == JSMN_STRING) {
-		printf("'%.*s'", t->end - t->start, js+t->start);
+		printf("'%.*s'", (int) JSMN_TOK_LEN(t), js+JSMN_TOK_START(t));
 		return 1;
 	} else if (t->type == JSMN_OBJECT) {
 		printf("\n");
 		j = 0;
-		for (i = 0; i < t->size; i++) {
+		for (i = 0; i < JSMN_TOK_SIZE(t); i++) {
 			for (k = 0; k < indent; k++) printf("  ");
 			j += dump(js, t+1+j, count-j, indent+1);
 			printf(": ");
@@ -50,7 +59,7 @@ static int dump(const char *js, jsmntok_t *t, size_t count, int indent) {
 	} else if (t->type == JSMN_ARRAY) {
 		j = 0;
 		printf("\n");
-		for (i = 0; i < t->size; i++) {
+		for (i = 0; i < JSMN_TOK_SIZE(t); i++) {
 			for (k = 0; k < indent-1; k++) printf("  ");
 			printf("   - ");
 			j += dump(js, t+1+j, count-j, indent+1);
@@ -69,19 +78,12 @@ int main() {
 	char buf[BUFSIZ];
 
 	jsmn_parser p;
-	jsmntok_t *tok;
-	size_t tokcount = 2;
+	jsmntok_t *tok = NULL;
+	jsmnuint_t tokcount = 0;
 
 	/* Prepare parser */
 	jsmn_init(&p);
 
-	/* Allocate some tokens as a start */
-	tok = malloc(sizeof(*tok) * tokcount);
-	if (tok == NULL) {
-		fprintf(stderr, "malloc(): errno=%d\n", errno);
-		return 3;
-	}
-
 	for (;;) {
 		/* Read another chunk */
 		r = fread(buf, 1, sizeof(buf), stdin);
@@ -105,16 +107,13 @@ int main() {
 		strncpy(js + jslen, buf, r);
 		jslen = jslen + r;
 
-again:
-		r = jsmn_parse(&p, js, jslen, tok, tokcount);
+		/* Tokens are allocated as needed */
+		r = jsmn_parse_ex(&p, js, jslen, &tok, &tokcount, realloc_tokens, NULL, 0);
 		if (r < 0) {
 			if (r == JSMN_ERROR_NOMEM) {
-				tokcount = tokcount * 2;
-				tok = realloc_it(tok, sizeof(*tok) * tokcount);
-				if (tok == NULL) {
-					return 3;
-				}
-				goto again;
+				fprintf(stderr, "realloc(): errno=%d\n", errno);
+				free(tok);
+				return 3;
 			}
 		} else {
 			dump(js, tok, p.toknext, 0);
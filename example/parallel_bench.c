@@ -0,0 +1,101 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "../jsmn.h"
+
+/*
+ * Scaling benchmark for jsmn_parse_parallel(): builds a large document of
+ * nested records and times the sequential parser against 1..N threads.
+ *
+ * Usage: parallel_bench [megabytes] [max threads]
+ */
+
+static double now(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static char *gen(size_t size, size_t *len) {
+	char *js = malloc(size + 256);
+	size_t n = 0;
+	unsigned long i = 0;
+
+	if (js == NULL) {
+		return NULL;
+	}
+	n += sprintf(js + n, "[");
+	while (n < size) {
+		n += sprintf(js + n,
+				"%s{\"id\": %lu, \"name\": \"user \\\"%lu\\\"\", \"score\": %lu.%02lu, "
+				"\"tags\": [\"a\", \"b,c\", \"{d}\"], \"nested\": {\"ok\": true, \"v\": null}}",
+				i > 0 ? ",\n" : "", i, i * 7, i % 1000, i % 100);
+		i++;
+	}
+	n += sprintf(js + n, "]");
+	*len = n;
+	return js;
+}
+
+static double run(const char *js, size_t len, jsmntok_t *t, jsmnuint_t num_tokens, unsigned int nthreads, jsmnint_t *r) {
+	jsmn_parser p;
+	double best = 0;
+	double t0;
+	int rep;
+
+	for (rep = 0; rep < 3; rep++) {
+		jsmn_init(&p);
+		t0 = now();
+		*r = nthreads == 0 ? jsmn_parse(&p, js, len, t, num_tokens) :
+				jsmn_parse_parallel(&p, js, len, t, num_tokens, nthreads);
+		t0 = now() - t0;
+		if (rep == 0 || t0 < best) {
+			best = t0;
+		}
+	}
+	return best;
+}
+
+int main(int argc, char *argv[]) {
+	size_t mb = argc > 1 ? strtoul(argv[1], NULL, 10) : 128;
+	unsigned int max = argc > 2 ? strtoul(argv[2], NULL, 10) : 8;
+	unsigned int nthreads;
+	size_t len;
+	char *js;
+	jsmntok_t *t;
+	jsmnuint_t num_tokens;
+	jsmn_parser p;
+	jsmnint_t r;
+	double base;
+	double sec;
+
+	js = gen(mb << 20, &len);
+	if (js == NULL) {
+		fprintf(stderr, "out of memory\n");
+		return 1;
+	}
+	jsmn_init(&p);
+	num_tokens = jsmn_parse(&p, js, len, NULL, 0);
+	t = malloc(sizeof(*t) * num_tokens);
+	if (t == NULL) {
+		fprintf(stderr, "out of memory\n");
+		return 1;
+	}
+	printf("%lu bytes, %lu tokens\n", (unsigned long) len, (unsigned long) num_tokens);
+
+	base = run(js, len, t, num_tokens, 0, &r);
+	printf("sequential  %8.1f ms %8.1f MB/s\n", base * 1e3, len / base / 1e6);
+	for (nthreads = 1; nthreads <= max; nthreads *= 2) {
+		sec = run(js, len, t, num_tokens, nthreads, &r);
+		if (r != (jsmnint_t) num_tokens) {
+			fprintf(stderr, "%u threads: got %ld tokens\n", nthreads, (long) r);
+			return 1;
+		}
+		printf("%2u threads  %8.1f ms %8.1f MB/s  x%.2f\n", nthreads, sec * 1e3, len / sec / 1e6, base / sec);
+	}
+
+	free(t);
+	free(js);
+	return 0;
+}
@@ -13,8 +13,8 @@ const char *JSON_STRING =
 	"\"groups\": [\"users\", \"wheel\", \"audio\", \"video\"]}";
 
 static int jsoneq(const char *json, jsmntok_t *tok, const char *s) {
-	if (tok->type == JSMN_STRING && (int) strlen(s) == tok->end - tok->start &&
-			strncmp(json + tok->start, s, tok->end - tok->start) == 0) {
+	if (tok->type == JSMN_STRING && (int) strlen(s) == JSMN_TOK_LEN(tok) &&
+			strncmp(json + JSMN_TOK_START(tok), s, JSMN_TOK_LEN(tok)) == 0) {
 		return 0;
 	}
 	return -1;
@@ -43,18 +43,18 @@ int main() {
 	for (i = 1; i < r; i++) {
 		if (jsoneq(JSON_STRING, &t[i], "user") == 0) {
 			/* We may use strndup() to fetch string value */
-			printf("- User: %.*s\n", t[i+1].end-t[i+1].start,
-					JSON_STRING + t[i+1].start);
+			printf("- User: %.*s\n", (int) JSMN_TOK_LEN(&t[i+1]),
+					JSON_STRING + JSMN_TOK_START(&t[i+1]));
 			i++;
 		} else if (jsoneq(JSON_STRING, &t[i], "admin") == 0) {
 			/* We may additionally check if the value is either "true" or "false" */
-			printf("- Admin: %.*s\n", t[i+1].end-t[i+1].start,
-					JSON_STRING + t[i+1].start);
+			printf("- Admin: %.*s\n", (int) JSMN_TOK_LEN(&t[i+1]),
+					JSON_STRING + JSMN_TOK_START(&t[i+1]));
 			i++;
 		} else if (jsoneq(JSON_STRING, &t[i], "uid") == 0) {
 			/* We may want to do strtol() here to get numeric value */
-			printf("- UID: %.*s\n", t[i+1].end-t[i+1].start,
-					JSON_STRING + t[i+1].start);
+			printf("- UID: %.*s\n", (int) JSMN_TOK_LEN(&t[i+1]),
+					JSON_STRING + JSMN_TOK_START(&t[i+1]));
 			i++;
 		} else if (jsoneq(JSON_STRING, &t[i], "groups") == 0) {
 			int j;
@@ -62,14 +62,14 @@ int main() {
 			if (t[i+1].type != JSMN_ARRAY) {
 				continue; /* We expect groups to be an array of strings */
 			}
-			for (j = 0; j < t[i+1].size; j++) {
+			for (j = 0; j < JSMN_TOK_SIZE(&t[i+1]); j++) {
 				jsmntok_t *g = &t[i+j+2];
-				printf("  * %.*s\n", g->end - g->start, JSON_STRING + g->start);
+				printf("  * %.*s\n", (int) JSMN_TOK_LEN(g), JSON_STRING + JSMN_TOK_START(g));
 			}
-			i += t[i+1].size + 1;
+			i += JSMN_TOK_SIZE(&t[i+1]) + 1;
 		} else {
-			printf("Unexpected key: %.*s\n", t[i].end-t[i].start,
-					JSON_STRING + t[i].start);
+			printf("Unexpected key: %.*s\n", (int) JSMN_TOK_LEN(&t[i]),
+					JSON_STRING + JSMN_TOK_START(&t[i]));
 		}
 	}
 	return 0;
@@ -1,6 +1,7 @@
 #include "jsmn.h"
 #ifdef JSMN_DOM
 #include "utf8.h"
+#include "pow10.h"
 #ifdef USE_LIBC
 #include <stdio.h>
 #include <string.h> /* for memcpy() and snprintf */
@@ -44,6 +45,384 @@ int naive_memcmp(const void *b1, const void *b2, size_t len) {
 #endif
 #endif
 
+#ifdef JSMN_SIMD
+/*
+ * Structural index.
+ * The first stage of the parser classifies a whole vector of bytes at once into a bitmap of the positions the
+ * token builder has to look at. Every other byte cannot change the parser state, and is skipped without being
+ * visited by the second stage.
+ */
+#if defined(__AVX2__)
+#include <immintrin.h>
+typedef __m256i jsmn_vec;
+#define JSMN_VEC_SIZE     32
+#define JSMN_VEC_ALL      0xFFFFFFFFu
+#define JSMN_VEC_LOAD(p)  _mm256_loadu_si256((const __m256i *) (p))
+#define JSMN_VEC_STORE(p, v) _mm256_storeu_si256((__m256i *) (p), (v))
+#define JSMN_VEC_EQ(v, c) _mm256_cmpeq_epi8((v), _mm256_set1_epi8(c))
+#define JSMN_VEC_LT(v, c) _mm256_cmpgt_epi8(_mm256_set1_epi8(c), (v))
+#define JSMN_VEC_OR(a, b) _mm256_or_si256((a), (b))
+#define JSMN_VEC_MASK(v)  ((unsigned int) _mm256_movemask_epi8(v))
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+typedef __m128i jsmn_vec;
+#define JSMN_VEC_SIZE     16
+#define JSMN_VEC_ALL      0xFFFFu
+#define JSMN_VEC_LOAD(p)  _mm_loadu_si128((const __m128i *) (p))
+#define JSMN_VEC_STORE(p, v) _mm_storeu_si128((__m128i *) (p), (v))
+#define JSMN_VEC_EQ(v, c) _mm_cmpeq_epi8((v), _mm_set1_epi8(c))
+#define JSMN_VEC_LT(v, c) _mm_cmplt_epi8((v), _mm_set1_epi8(c))
+#define JSMN_VEC_OR(a, b) _mm_or_si128((a), (b))
+#define JSMN_VEC_MASK(v)  ((unsigned int) _mm_movemask_epi8(v))
+#endif
+
+#if defined(__GNUC__)
+#define JSMN_CTZ(m) __builtin_ctz(m)
+#else
+static int jsmn_ctz(unsigned int m) {
+	int n;
+
+	for (n = 0; (m & 1) == 0; n++) {
+		m >>= 1;
+	}
+
+	return n;
+}
+#define JSMN_CTZ(m) jsmn_ctz(m)
+#endif
+
+/*
+ * Structural index classes: the bytes each stage of the parser stops at.
+ */
+enum jsmnindex {
+	JSMN_INDEX_VALUE = 0, /* anything but whitespace */
+	JSMN_INDEX_STRING,    /* '"', '\\' and '\0' */
+	JSMN_INDEX_PRIMITIVE, /* delimiters, control and non-ASCII bytes */
+	JSMN_INDEX_LINE,      /* '\n' */
+	JSMN_INDEX_ESCAPE,    /* '\\' and non-ASCII bytes */
+	JSMN_INDEX_QUOTE      /* '"', '\\' and control bytes */
+};
+
+static int jsmn_index_byte(unsigned char c, enum jsmnindex class) {
+	switch (class) {
+		case JSMN_INDEX_VALUE:
+			return c != ' ' && c != '\t' && c != '\r' && c != '\n';
+		case JSMN_INDEX_STRING:
+			return c == '\"' || c == '\\' || c == '\0';
+		case JSMN_INDEX_PRIMITIVE:
+			return c < 32 || c >= 127 || c == ' ' || c == ',' || c == ']' || c == '}'
+#ifndef JSMN_STRICT
+				|| c == ':'
+#endif
+				;
+		case JSMN_INDEX_LINE:
+			return c == '\n';
+		case JSMN_INDEX_ESCAPE:
+			return c == '\\' || c >= 0x80;
+		case JSMN_INDEX_QUOTE:
+			return c == '\"' || c == '\\' || c < 0x20;
+	}
+	return 1;
+}
+
+#ifdef JSMN_VEC_SIZE
+/*
+ * Returns the bitmap of the JSMN_VEC_SIZE bytes at `p`, with a bit set for each byte `class` stops at.
+ */
+static unsigned int jsmn_index_vec(const char *p, enum jsmnindex class) {
+	jsmn_vec v;
+	jsmn_vec m;
+
+	v = JSMN_VEC_LOAD(p);
+
+	switch (class) {
+		case JSMN_INDEX_VALUE:
+			m = JSMN_VEC_OR(JSMN_VEC_OR(JSMN_VEC_EQ(v, ' '),  JSMN_VEC_EQ(v, '\t')),
+			                JSMN_VEC_OR(JSMN_VEC_EQ(v, '\r'), JSMN_VEC_EQ(v, '\n')));
+			return ~JSMN_VEC_MASK(m) & JSMN_VEC_ALL;
+		case JSMN_INDEX_STRING:
+			m = JSMN_VEC_OR(JSMN_VEC_OR(JSMN_VEC_EQ(v, '\"'), JSMN_VEC_EQ(v, '\\')), JSMN_VEC_EQ(v, '\0'));
+			return JSMN_VEC_MASK(m);
+		case JSMN_INDEX_PRIMITIVE:
+			/* signed compare: control bytes and bytes >= 0x80 are both below 32 */
+			m = JSMN_VEC_OR(JSMN_VEC_LT(v, 32),  JSMN_VEC_EQ(v, 127));
+			m = JSMN_VEC_OR(m, JSMN_VEC_OR(JSMN_VEC_EQ(v, ' '), JSMN_VEC_EQ(v, ',')));
+			m = JSMN_VEC_OR(m, JSMN_VEC_OR(JSMN_VEC_EQ(v, ']'), JSMN_VEC_EQ(v, '}')));
+#ifndef JSMN_STRICT
+			m = JSMN_VEC_OR(m, JSMN_VEC_EQ(v, ':'));
+#endif
+			return JSMN_VEC_MASK(m);
+		case JSMN_INDEX_LINE:
+			return JSMN_VEC_MASK(JSMN_VEC_EQ(v, '\n'));
+		case JSMN_INDEX_ESCAPE:
+			return JSMN_VEC_MASK(JSMN_VEC_OR(JSMN_VEC_EQ(v, '\\'), JSMN_VEC_LT(v, 0)));
+		case JSMN_INDEX_QUOTE:
+			/* signed compare: bytes >= 0x80 are below 32 too, and are taken out by their top bit */
+			return JSMN_VEC_MASK(JSMN_VEC_OR(JSMN_VEC_EQ(v, '\"'), JSMN_VEC_EQ(v, '\\'))) |
+				(JSMN_VEC_MASK(JSMN_VEC_LT(v, 32)) & ~JSMN_VEC_MASK(v));
+	}
+	return 1;
+}
+#endif
+
+/*
+ * Returns the offset of the first byte at or after `pos` that `class` stops at, or `len` if there is none.
+ */
+static size_t jsmn_index_next(const char *js, size_t pos, size_t len, enum jsmnindex class) {
+#ifdef JSMN_VEC_SIZE
+	unsigned int mask;
+
+	/* the common case of a token right at the cursor */
+	if (pos < len && jsmn_index_byte(js[pos], class)) {
+		return pos;
+	}
+
+	for (; pos + JSMN_VEC_SIZE <= len; pos += JSMN_VEC_SIZE) {
+		mask = jsmn_index_vec(js + pos, class);
+		if (mask != 0) {
+			return pos + JSMN_CTZ(mask);
+		}
+	}
+#endif
+
+	for (; pos < len; pos++) {
+		if (jsmn_index_byte(js[pos], class)) {
+			break;
+		}
+	}
+
+	return pos;
+}
+
+/*
+ * Returns whether the `n` bytes at `p` are all 7-bit: the vector mask is their top bits.
+ */
+static int jsmn_index_ascii(const char *p, size_t n) {
+	unsigned char high = 0;
+	size_t i = 0;
+
+#ifdef JSMN_VEC_SIZE
+	for (; i + JSMN_VEC_SIZE <= n; i += JSMN_VEC_SIZE) {
+		if (JSMN_VEC_MASK(JSMN_VEC_LOAD(p + i)) != 0) {
+			return 0;
+		}
+	}
+#endif
+	for (; i < n; i++) {
+		high |= (unsigned char) p[i];
+	}
+	return (high & 0x80) == 0;
+}
+
+#if defined(JSMN_VALIDATE_UTF8) && defined(JSMN_VEC_SIZE) && (defined(__AVX2__) || defined(__SSSE3__))
+/*
+ * UTF-8 validation by table lookup (Keiser and Lemire): the high nibble of a byte, the
+ * low nibble of the byte before it and the high nibble of this one each select the set of
+ * errors they could take part in; a byte is bad when all three agree on one. Lead bytes of
+ * three and four byte sequences are checked against the continuation bytes they need.
+ */
+#define JSMN_UTF8_LOOKUP
+#if defined(__AVX2__)
+#define JSMN_VEC_ZERO          _mm256_setzero_si256()
+#define JSMN_VEC_SET(c)        _mm256_set1_epi8((char) (c))
+#define JSMN_VEC_AND(a, b)     _mm256_and_si256((a), (b))
+#define JSMN_VEC_XOR(a, b)     _mm256_xor_si256((a), (b))
+#define JSMN_VEC_SUBS(a, b)    _mm256_subs_epu8((a), (b))
+#define JSMN_VEC_LOW(v)        _mm256_and_si256((v), _mm256_set1_epi8(0x0F))
+#define JSMN_VEC_HIGH(v)       _mm256_and_si256(_mm256_srli_epi16((v), 4), _mm256_set1_epi8(0x0F))
+#define JSMN_VEC_LOOKUP(t, v)  _mm256_shuffle_epi8(_mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *) (t))), (v))
+#define JSMN_VEC_PREV(v, p, n) _mm256_alignr_epi8((v), _mm256_permute2x128_si256((p), (v), 0x21), 16 - (n))
+#else
+#include <tmmintrin.h>
+#define JSMN_VEC_ZERO          _mm_setzero_si128()
+#define JSMN_VEC_SET(c)        _mm_set1_epi8((char) (c))
+#define JSMN_VEC_AND(a, b)     _mm_and_si128((a), (b))
+#define JSMN_VEC_XOR(a, b)     _mm_xor_si128((a), (b))
+#define JSMN_VEC_SUBS(a, b)    _mm_subs_epu8((a), (b))
+#define JSMN_VEC_LOW(v)        _mm_and_si128((v), _mm_set1_epi8(0x0F))
+#define JSMN_VEC_HIGH(v)       _mm_and_si128(_mm_srli_epi16((v), 4), _mm_set1_epi8(0x0F))
+#define JSMN_VEC_LOOKUP(t, v)  _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) (t)), (v))
+#define JSMN_VEC_PREV(v, p, n) _mm_alignr_epi8((v), (p), 16 - (n))
+#endif
+
+/* Error bits: too short 0x01, too long 0x02, overlong 3 0x04, too large 0x08, surrogate 0x10,
+ * overlong 2 0x20, too large 1000 or overlong 4 0x40, two continuations 0x80 */
+static const unsigned char jsmn_utf8_byte_1_high[16] = {
+	0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x80, 0x80, 0x80, 0x80, 0x21, 0x01, 0x15, 0x49
+};
+static const unsigned char jsmn_utf8_byte_1_low[16] = {
+	0xE7, 0xA3, 0x83, 0x83, 0x8B, 0xCB, 0xCB, 0xCB, 0xCB, 0xCB, 0xCB, 0xCB, 0xCB, 0xDB, 0xCB, 0xCB
+};
+static const unsigned char jsmn_utf8_byte_2_high[16] = {
+	0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0xE6, 0xAE, 0xBA, 0xBA, 0x01, 0x01, 0x01, 0x01
+};
+static const unsigned char jsmn_utf8_max[32] = {
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xEF, 0xDF, 0xBF
+};
+
+/*
+ * Returns whether the `n` bytes at `p` are well-formed UTF-8.
+ */
+static int jsmn_index_utf8(const char *p, size_t n) {
+	char tail[JSMN_VEC_SIZE];
+	jsmn_vec input;
+	jsmn_vec prev;
+	jsmn_vec prev1;
+	jsmn_vec special;
+	jsmn_vec must23;
+	jsmn_vec error;
+	jsmn_vec incomplete;
+	size_t i;
+	size_t k;
+
+	prev       = JSMN_VEC_ZERO;
+	error      = JSMN_VEC_ZERO;
+	incomplete = JSMN_VEC_ZERO;
+
+	/* the last vector is padded with zeros, which also ends any open sequence */
+	for (i = 0; i <= n; i += JSMN_VEC_SIZE) {
+		if (i + JSMN_VEC_SIZE <= n) {
+			input = JSMN_VEC_LOAD(p + i);
+		} else {
+			for (k = 0; k < JSMN_VEC_SIZE; k++) {
+				tail[k] = i + k < n ? p[i + k] : 0;
+			}
+			input = JSMN_VEC_LOAD(tail);
+		}
+
+		if (JSMN_VEC_MASK(input) == 0) {
+			error = JSMN_VEC_OR(error, incomplete);
+			incomplete = JSMN_VEC_ZERO;
+			prev = input;
+			continue;
+		}
+		prev1 = JSMN_VEC_PREV(input, prev, 1);
+		special = JSMN_VEC_AND(JSMN_VEC_AND(JSMN_VEC_LOOKUP(jsmn_utf8_byte_1_high, JSMN_VEC_HIGH(prev1)),
+		                                    JSMN_VEC_LOOKUP(jsmn_utf8_byte_1_low,  JSMN_VEC_LOW(prev1))),
+		                       JSMN_VEC_LOOKUP(jsmn_utf8_byte_2_high, JSMN_VEC_HIGH(input)));
+		/* the bytes two and three after a three or four byte lead must be continuations */
+		must23 = JSMN_VEC_OR(JSMN_VEC_SUBS(JSMN_VEC_PREV(input, prev, 2), JSMN_VEC_SET(0xE0 - 0x80)),
+		                     JSMN_VEC_SUBS(JSMN_VEC_PREV(input, prev, 3), JSMN_VEC_SET(0xF0 - 0x80)));
+		error = JSMN_VEC_OR(error, JSMN_VEC_XOR(JSMN_VEC_AND(must23, JSMN_VEC_SET(0x80)), special));
+		/* a lead byte too close to the end for its sequence to finish in this vector */
+		incomplete = JSMN_VEC_SUBS(input, JSMN_VEC_LOAD(jsmn_utf8_max + sizeof(jsmn_utf8_max) - JSMN_VEC_SIZE));
+		prev = input;
+	}
+	error = JSMN_VEC_OR(error, incomplete);
+
+	return JSMN_VEC_MASK(JSMN_VEC_EQ(error, 0)) == JSMN_VEC_ALL;
+}
+#endif
+
+/*
+ * Bitmaps of a 64-byte block, one bit per byte.
+ */
+struct jsmn_block {
+	unsigned long long quote;      /* '"' */
+	unsigned long long backslash;  /* '\\' */
+	unsigned long long open;       /* '{' and '[' */
+	unsigned long long close;      /* '}' and ']' */
+	unsigned long long delimiter;  /* whitespace, ',' and ':' */
+	unsigned long long nul;        /* '\0' */
+};
+
+static void jsmn_index_block(const char *p, struct jsmn_block *b) {
+	int i;
+#ifdef JSMN_VEC_SIZE
+	jsmn_vec v;
+#endif
+
+	b->quote = b->backslash = b->open = b->close = b->delimiter = b->nul = 0;
+
+#ifdef JSMN_VEC_SIZE
+	for (i = 0; i < 64; i += JSMN_VEC_SIZE) {
+		v = JSMN_VEC_LOAD(p + i);
+		b->quote     |= (unsigned long long) JSMN_VEC_MASK(JSMN_VEC_EQ(v, '\"')) << i;
+		b->backslash |= (unsigned long long) JSMN_VEC_MASK(JSMN_VEC_EQ(v, '\\')) << i;
+		b->open      |= (unsigned long long) JSMN_VEC_MASK(JSMN_VEC_OR(JSMN_VEC_EQ(v, '{'), JSMN_VEC_EQ(v, '['))) << i;
+		b->close     |= (unsigned long long) JSMN_VEC_MASK(JSMN_VEC_OR(JSMN_VEC_EQ(v, '}'), JSMN_VEC_EQ(v, ']'))) << i;
+		b->delimiter |= (unsigned long long) JSMN_VEC_MASK(JSMN_VEC_OR(
+			JSMN_VEC_OR(JSMN_VEC_OR(JSMN_VEC_EQ(v, ' '),  JSMN_VEC_EQ(v, '\t')),
+			            JSMN_VEC_OR(JSMN_VEC_EQ(v, '\r'), JSMN_VEC_EQ(v, '\n'))),
+			JSMN_VEC_OR(JSMN_VEC_EQ(v, ','), JSMN_VEC_EQ(v, ':')))) << i;
+		b->nul       |= (unsigned long long) JSMN_VEC_MASK(JSMN_VEC_EQ(v, '\0')) << i;
+	}
+#else
+	for (i = 0; i < 64; i++) {
+		switch (p[i]) {
+			case '\"':
+				b->quote     |= 1ULL << i;
+				break;
+			case '\\':
+				b->backslash |= 1ULL << i;
+				break;
+			case '{': case '[':
+				b->open      |= 1ULL << i;
+				break;
+			case '}': case ']':
+				b->close     |= 1ULL << i;
+				break;
+			case '\t': case '\r': case '\n': case ' ':
+			case ',':  case ':':
+				b->delimiter |= 1ULL << i;
+				break;
+			case '\0':
+				b->nul       |= 1ULL << i;
+				break;
+		}
+	}
+#endif
+}
+
+/*
+ * Bitmap of the bytes escaped by a backslash, carrying a pending escape across blocks in `*carry`.
+ * A run of backslashes escapes the byte after it when the run has an odd length.
+ */
+static unsigned long long jsmn_index_escaped(unsigned long long backslash, unsigned long long *carry) {
+	const unsigned long long even = 0x5555555555555555ULL;
+	unsigned long long follows;
+	unsigned long long odd_starts;
+	unsigned long long even_runs;
+
+	backslash &= ~*carry;
+	follows    = backslash << 1 | *carry;
+	odd_starts = backslash & ~even & ~follows;
+	even_runs  = odd_starts + backslash;
+	*carry     = even_runs < backslash;
+
+	return (even ^ (even_runs << 1)) & follows;
+}
+
+/*
+ * Bitmap with every bit set from a set bit up to, but not including, the next set bit.
+ */
+static unsigned long long jsmn_index_prefix_xor(unsigned long long m) {
+	m ^= m << 1;
+	m ^= m << 2;
+	m ^= m << 4;
+	m ^= m << 8;
+	m ^= m << 16;
+	m ^= m << 32;
+
+	return m;
+}
+
+static int jsmn_popcount(unsigned long long m) {
+#if defined(__GNUC__)
+	return __builtin_popcountll(m);
+#else
+	int n;
+
+	for (n = 0; m != 0; n++) {
+		m &= m - 1;
+	}
+
+	return n;
+#endif
+}
+#endif
+
 /**
  * Allocates a fresh unused token from the token pull.
  */
@@ -54,8 +433,17 @@ static jsmntok_t *jsmn_alloc_token(jsmn_parser *parser,
 		return NULL;
 	}
 	tok = &tokens[parser->toknext++];
+#ifdef JSMN_COMPACT
+	tok->start = (unsigned int) -1;
+	tok->type = JSMN_UNDEFINED;
+	tok->flag = 0;
+	tok->count = 0;
+#else
 	tok->start = tok->end = -1;
-#ifdef JSMN_DOM
+	tok->flags = 0;
+#endif
+#ifdef JSMN_COMPACT
+#elif defined(JSMN_DOM)
 	tok->family.parent = -1;
 	tok->family.siblings.prev = -1;
 	tok->family.siblings.next = -1;
@@ -66,6 +454,9 @@ static jsmntok_t *jsmn_alloc_token(jsmn_parser *parser,
 #ifdef JSMN_PARENT_LINKS
 	tok->parent = -1;
 #endif
+#ifdef JSMN_SKIP_LINKS
+	tok->skip = parser->toknext;
+#endif
 #endif
 	return tok;
 }
@@ -74,15 +465,249 @@ static jsmntok_t *jsmn_alloc_token(jsmn_parser *parser,
  * Fills token type and boundaries.
  */
 static void jsmn_fill_token(jsmntok_t *token, jsmntype_t type,
-                            int start, int end) {
+                            jsmnint_t start, jsmnint_t end) {
 	token->type = type;
 	token->start = start;
+#ifdef JSMN_COMPACT
+	token->flag = 0;
+	token->count = end - start;
+#else
+	token->flags = 0;
 	token->end = end;
 #ifdef JSMN_DOM
 #else
 	token->size = 0;
 #endif
+#endif
+}
+
+#ifdef JSMN_DOM
+/**
+ * Marks the objects and arrays from token `i` up to the root as changed, so the emitter no
+ * longer copies their original text. Stops at the first one already marked: its own
+ * ancestors were marked with it.
+ */
+static void jsmn_dom_touch(jsmntok_t *tokens, jsmnuint_t num_tokens, jsmnint_t i) {
+	while (i >= 0 && i < (jsmnint_t) num_tokens) {
+		if (tokens[i].type == JSMN_OBJECT || tokens[i].type == JSMN_ARRAY) {
+			if (tokens[i].flags & JSMN_DOM_DIRTY) {
+				return;
+			}
+			tokens[i].flags |= JSMN_DOM_DIRTY;
+		}
+		i = tokens[i].family.parent;
+	}
+}
+
+/**
+ * Links token `i` in as the last child of `parent_i`, without marking anything changed.
+ */
+static jsmnint_t jsmn_dom_link(jsmntok_t *tokens, jsmnuint_t num_tokens, jsmnint_t parent_i, jsmnint_t i) {
+	if (i == -1 || i >= (jsmnint_t) num_tokens || parent_i >= (jsmnint_t) num_tokens) {
+		return JSMN_ERROR_INVAL;
+	}
+
+	tokens[i].family.parent = parent_i;
+	if (parent_i != -1) {
+		if (    tokens[parent_i].family.children.first == -1) {
+			tokens[parent_i].family.children.first = i;
+			tokens[parent_i].family.children.last  = i;
+		} else {
+			tokens[i].family.siblings.prev = tokens[parent_i].family.children.last;
+			tokens[tokens[parent_i].family.children.last].family.siblings.next = i;
+			tokens[parent_i].family.children.last  = i;
+		}
+	}
+
+	return i;
+}
+#endif
+
+#ifndef JSMN_DOM
+/**
+ * Fills object or array token type and start, leaving it open.
+ */
+static void jsmn_open_token(jsmntok_t *token, jsmntype_t type, jsmnint_t start) {
+	token->type = type;
+	token->start = start;
+#ifdef JSMN_COMPACT
+	token->flag = 1;
+#endif
+}
+
+/**
+ * Closes an object or array token at `end`.
+ */
+static void jsmn_close_token(jsmntok_t *token, jsmnint_t end) {
+#ifdef JSMN_COMPACT
+	(void) end;
+	token->flag = 0;
+#else
+	token->end = end;
+#endif
+}
+
+/**
+ * Returns whether a token is an object or array that is still open.
+ */
+static int jsmn_token_is_open(const jsmntok_t *token) {
+#ifdef JSMN_COMPACT
+	return (token->type == JSMN_OBJECT || token->type == JSMN_ARRAY) && token->flag;
+#else
+	return token->start != -1 && token->end == -1;
+#endif
+}
+
+/**
+ * Counts one more child of `token`: a member, element or key value.
+ */
+static int jsmn_add_child(jsmntok_t *token) {
+#ifdef JSMN_COMPACT
+	if (token->type == JSMN_OBJECT || token->type == JSMN_ARRAY) {
+		if (token->count == JSMN_COMPACT_MAX) {
+			return JSMN_ERROR_INVAL;
+		}
+		token->count++;
+	} else {
+		token->flag = 1;
+	}
+#else
+	token->size++;
+#endif
+	return 0;
+}
+#endif
+
+#ifdef JSMN_SKIP_LINKS
+/**
+ * Points token `i`, and the key it is the value of, past the tokens allocated so far.
+ */
+static void jsmn_skip_links(jsmn_parser *parser, jsmntok_t *tokens, jsmnint_t i) {
+	tokens[i].skip = parser->toknext;
+	/* A key is allocated right before its value, and only keys, quoted or not, are
+	 * strings or primitives with a size of 1 */
+	if (i > 0 && tokens[i - 1].type != JSMN_OBJECT && tokens[i - 1].type != JSMN_ARRAY && tokens[i - 1].size == 1) {
+		tokens[i - 1].skip = parser->toknext;
+	}
+}
+#endif
+
+#if !defined(JSMN_DOM) && !defined(JSMN_PARENT_LINKS)
+/**
+ * Returns the innermost open object or array, or -1 if there is none.
+ */
+static jsmnint_t jsmn_open_top(jsmn_parser *parser, jsmntok_t *tokens) {
+	jsmnint_t i;
+
+	if (parser->depth == 0) {
+		return -1;
+	}
+	if (parser->depth <= JSMN_STACK_SIZE) {
+		return parser->stack[parser->depth - 1];
+	}
+
+	/* Nested deeper than the stack: find the latest open token. */
+	for (i = parser->toknext - 1; i >= 0; i--) {
+		if (jsmn_token_is_open(&tokens[i])) {
+			return i;
+		}
+	}
+	return -1;
+}
+#endif
+
+#ifndef JSMN_COMPACT
+/**
+ * Returns the JSMN_PRIMITIVE_* class of the primitive from `start` to `end`. Primitives are
+ * short, so this second look costs little next to re-reading them on every query.
+ */
+static unsigned char jsmn_primitive_flags(const char *js, jsmnint_t start, jsmnint_t end) {
+	static const char max_u64[] = "18446744073709551615";
+	static const char max_neg[] = "9223372036854775808";
+	const char *limit;
+	jsmnint_t pos;
+	jsmnint_t digits;
+	jsmnint_t k;
+	int fraction;
+
+	switch (end - start) {
+	case 4:
+		if (js[start] == 'n' && js[start + 1] == 'u' && js[start + 2] == 'l' && js[start + 3] == 'l') {
+			return JSMN_PRIMITIVE_NULL;
+		}
+		if (js[start] == 't' && js[start + 1] == 'r' && js[start + 2] == 'u' && js[start + 3] == 'e') {
+			return JSMN_PRIMITIVE_TRUE;
+		}
+		break;
+	case 5:
+		if (js[start] == 'f' && js[start + 1] == 'a' && js[start + 2] == 'l' && js[start + 3] == 's' && js[start + 4] == 'e') {
+			return JSMN_PRIMITIVE_FALSE;
+		}
+		break;
+	}
+
+	pos = start + (js[start] == '-');
+	while (pos < end && js[pos] == '0') {
+		pos++;
+	}
+	k = pos;
+	for (; pos < end && js[pos] >= '0' && js[pos] <= '9'; pos++) {
+		/* pass */
+	}
+	digits = pos - k;
+	if (pos == k && (k == start || js[k - 1] != '0')) {
+		return 0;
+	}
+
+	fraction = 0;
+	if (pos < end && js[pos] == '.') {
+		for (k = ++pos; pos < end && js[pos] >= '0' && js[pos] <= '9'; pos++) {
+			/* pass */
+		}
+		if (pos == k) {
+			return 0;
+		}
+		fraction = 1;
+	}
+	if (pos < end && (js[pos] == 'e' || js[pos] == 'E')) {
+		pos++;
+		if (pos < end && (js[pos] == '-' || js[pos] == '+')) {
+			pos++;
+		}
+		for (k = pos; pos < end && js[pos] >= '0' && js[pos] <= '9'; pos++) {
+			/* pass */
+		}
+		if (pos == k) {
+			return 0;
+		}
+		fraction = 1;
+	}
+	if (pos != end) {
+		return 0;
+	}
+	if (fraction) {
+		return JSMN_PRIMITIVE_FLOAT;
+	}
+
+	/* up to 18 digits always fit, 19 or 20 are compared with the limit of their sign */
+	limit = js[start] == '-' ? max_neg : max_u64;
+	if (digits < 19) {
+		return JSMN_PRIMITIVE_INTEGER;
+	}
+	if (digits == 19 && js[start] != '-') {
+		return JSMN_PRIMITIVE_INTEGER;
+	}
+	if (digits > (jsmnint_t) (js[start] == '-' ? sizeof(max_neg) : sizeof(max_u64)) - 1) {
+		return JSMN_PRIMITIVE_FLOAT;
+	}
+	for (k = 0; k < digits; k++) {
+		if (js[end - digits + k] != limit[k]) {
+			return js[end - digits + k] < limit[k] ? JSMN_PRIMITIVE_INTEGER : JSMN_PRIMITIVE_FLOAT;
+		}
+	}
+	return JSMN_PRIMITIVE_INTEGER;
 }
+#endif
 
 /**
  * Fills next available token with JSON primitive.
@@ -92,14 +717,20 @@ static int jsmn_parse_primitive(jsmn_parser *parser, const char *js,
 #ifndef JSMN_DOM
 	jsmntok_t *token;
 #endif
-	int start;
+	jsmnint_t start;
 #ifdef JSMN_DOM
-	int dom_i;
+	jsmnint_t dom_i;
 #endif
 
 	start = parser->pos;
 
 	for (; parser->pos < len && js[parser->pos] != '\0'; parser->pos++) {
+#ifdef JSMN_SIMD
+		parser->pos = jsmn_index_next(js, parser->pos, len, JSMN_INDEX_PRIMITIVE);
+		if (parser->pos >= len || js[parser->pos] == '\0') {
+			break;
+		}
+#endif
 		switch (js[parser->pos]) {
 #ifndef JSMN_STRICT
 			/* In strict mode primitive must be followed by "," or "}" or "]" */
@@ -131,18 +762,28 @@ found:
 		parser->pos = start;
 		return dom_i;
 	}
-	dom_i = jsmn_dom_add(parser, tokens, num_tokens, parser->toksuper, dom_i);
+	tokens[dom_i].flags = jsmn_primitive_flags(js, start, parser->pos);
+	dom_i = jsmn_dom_link(tokens, num_tokens, parser->toksuper, dom_i);
 	if (dom_i < 0) {
 		parser->pos = start;
 		return dom_i;
 	}
 #else
+#ifdef JSMN_COMPACT
+	if (parser->pos - start > JSMN_COMPACT_MAX) {
+		parser->pos = start;
+		return JSMN_ERROR_INVAL;
+	}
+#endif
 	token = jsmn_alloc_token(parser, tokens, num_tokens);
 	if (token == NULL) {
 		parser->pos = start;
 		return JSMN_ERROR_NOMEM;
 	}
 	jsmn_fill_token(token, JSMN_PRIMITIVE, start, parser->pos);
+#ifndef JSMN_COMPACT
+	token->flags = jsmn_primitive_flags(js, start, parser->pos);
+#endif
 #ifdef JSMN_PARENT_LINKS
 	token->parent = parser->toksuper;
 #endif
@@ -151,27 +792,146 @@ found:
 	return 0;
 }
 
+#ifndef JSMN_COMPACT
 /**
- * Fills next token with JSON string.
+ * Returns the JSMN_STRING_* flags of the string from `start` to `end`.
  */
-static int jsmn_parse_string(jsmn_parser *parser, const char *js,
-		size_t len, jsmntok_t *tokens, size_t num_tokens) {
-#ifdef JSMN_DOM
-	int dom_i;
+static unsigned char jsmn_string_flags(const char *js, jsmnint_t start, jsmnint_t end, int escaped, unsigned char high) {
+	unsigned char flags = escaped ? 0 : JSMN_STRING_NOESCAPE;
+
+#ifdef JSMN_SIMD
+	/* the scan skipped the plain bytes */
+	(void) high;
+	if (jsmn_index_ascii(js + start, end - start)) {
+		flags |= JSMN_STRING_ASCII;
+	}
 #else
-	jsmntok_t *token;
+	(void) js; (void) start; (void) end;
+	if ((high & 0x80) == 0) {
+		flags |= JSMN_STRING_ASCII;
+	}
+#endif
+	return flags;
+}
 #endif
 
-	int start = parser->pos;
-
-	parser->pos++;
-
-	/* Skip starting quote */
-	for (; parser->pos < len && js[parser->pos] != '\0'; parser->pos++) {
-		char c = js[parser->pos];
-
-		/* Quote: end of string */
+#ifdef JSMN_VALIDATE_UTF8
+/**
+ * Returns whether the string from `start` to `end` is well-formed UTF-8.
+ */
+static int jsmn_string_utf8(const char *js, jsmnint_t start, jsmnint_t end, unsigned char high) {
+	const unsigned char *p = (const unsigned char *) js + start;
+	size_t n = end - start;
+	size_t i = 0;
+	size_t k;
+	size_t need;
+	unsigned char lo;
+	unsigned char hi;
+
+#ifdef JSMN_UTF8_LOOKUP
+	(void) high; (void) i; (void) k; (void) need; (void) lo; (void) hi;
+	return jsmn_index_utf8((const char *) p, n);
+#else
+#ifdef JSMN_SIMD
+	/* the scan skipped the plain bytes */
+	(void) high;
+#else
+	if ((high & 0x80) == 0) {
+		return 1;
+	}
+#endif
+	while (i < n) {
+#ifdef JSMN_VEC_SIZE
+		if (i + JSMN_VEC_SIZE <= n && JSMN_VEC_MASK(JSMN_VEC_LOAD(p + i)) == 0) {
+			i += JSMN_VEC_SIZE;
+			continue;
+		}
+#endif
+		if (p[i] < 0x80) {
+			i++;
+			continue;
+		}
+		/* lead byte, and the range of the byte after it that keeps the sequence short and in range */
+		lo = 0x80;
+		hi = 0xBF;
+		if (p[i] >= 0xC2 && p[i] <= 0xDF) {
+			need = 1;
+		} else if (p[i] >= 0xE0 && p[i] <= 0xEF) {
+			need = 2;
+			if (p[i] == 0xE0) {
+				lo = 0xA0;
+			} else if (p[i] == 0xED) {
+				hi = 0x9F;
+			}
+		} else if (p[i] >= 0xF0 && p[i] <= 0xF4) {
+			need = 3;
+			if (p[i] == 0xF0) {
+				lo = 0x90;
+			} else if (p[i] == 0xF4) {
+				hi = 0x8F;
+			}
+		} else {
+			return 0;
+		}
+		if (n - i <= need || p[i + 1] < lo || p[i + 1] > hi) {
+			return 0;
+		}
+		for (k = 2; k <= need; k++) {
+			if ((p[i + k] & 0xC0) != 0x80) {
+				return 0;
+			}
+		}
+		i += need + 1;
+	}
+	return 1;
+#endif
+}
+#endif
+
+/**
+ * Fills next token with JSON string.
+ */
+static int jsmn_parse_string(jsmn_parser *parser, const char *js,
+		size_t len, jsmntok_t *tokens, size_t num_tokens) {
+#ifdef JSMN_DOM
+	jsmnint_t dom_i;
+#else
+	jsmntok_t *token;
+#endif
+#ifndef JSMN_COMPACT
+	int escaped = 0;
+#endif
+#if !defined(JSMN_COMPACT) || defined(JSMN_VALIDATE_UTF8)
+	unsigned char high = 0; /* bits of every byte seen */
+#endif
+
+	jsmnint_t start = parser->pos;
+
+	parser->pos++;
+
+	/* Skip starting quote */
+	for (; parser->pos < len && js[parser->pos] != '\0'; parser->pos++) {
+		char c;
+
+#ifdef JSMN_SIMD
+		parser->pos = jsmn_index_next(js, parser->pos, len, JSMN_INDEX_STRING);
+		if (parser->pos >= len || js[parser->pos] == '\0') {
+			break;
+		}
+#endif
+		c = js[parser->pos];
+#if !defined(JSMN_COMPACT) || defined(JSMN_VALIDATE_UTF8)
+		high |= (unsigned char) c;
+#endif
+
+		/* Quote: end of string */
 		if (c == '\"') {
+#ifdef JSMN_VALIDATE_UTF8
+			if (!jsmn_string_utf8(js, start + 1, parser->pos, high)) {
+				parser->pos = start;
+				return JSMN_ERROR_INVAL;
+			}
+#endif
 			if (tokens == NULL) {
 				return 0;
 			}
@@ -181,18 +941,28 @@ static int jsmn_parse_string(jsmn_parser *parser, const char *js,
 				parser->pos = start;
 				return dom_i;
 			}
-			dom_i = jsmn_dom_add(parser, tokens, num_tokens, parser->toksuper, dom_i);
+			dom_i = jsmn_dom_link(tokens, num_tokens, parser->toksuper, dom_i);
 			if (dom_i < 0) {
 				parser->pos = start;
 				return dom_i;
 			}
+			tokens[dom_i].flags = jsmn_string_flags(js, start + 1, parser->pos, escaped, high);
 #else
+#ifdef JSMN_COMPACT
+			if (parser->pos - (start + 1) > JSMN_COMPACT_MAX) {
+				parser->pos = start;
+				return JSMN_ERROR_INVAL;
+			}
+#endif
 			token = jsmn_alloc_token(parser, tokens, num_tokens);
 			if (token == NULL) {
 				parser->pos = start;
 				return JSMN_ERROR_NOMEM;
 			}
 			jsmn_fill_token(token, JSMN_STRING, start+1, parser->pos);
+#ifndef JSMN_COMPACT
+			token->flags = jsmn_string_flags(js, start + 1, parser->pos, escaped, high);
+#endif
 #ifdef JSMN_PARENT_LINKS
 			token->parent = parser->toksuper;
 #endif
@@ -203,6 +973,9 @@ static int jsmn_parse_string(jsmn_parser *parser, const char *js,
 		/* Backslash: Quoted symbol expected */
 		if (c == '\\' && parser->pos + 1 < len) {
 			int i;
+#ifndef JSMN_COMPACT
+			escaped = 1;
+#endif
 			parser->pos++;
 			switch (js[parser->pos]) {
 				/* Allowed escaped symbols */
@@ -238,22 +1011,28 @@ static int jsmn_parse_string(jsmn_parser *parser, const char *js,
 /**
  * Parse JSON string and fill tokens.
  */
-int jsmn_parse(jsmn_parser *parser, const char *js, size_t len,
-		jsmntok_t *tokens, unsigned int num_tokens) {
+jsmnint_t jsmn_parse(jsmn_parser *parser, const char *js, size_t len,
+		jsmntok_t *tokens, jsmnuint_t num_tokens) {
 	int r;
 #ifndef JSMN_DOM
-	int i;
+	jsmnint_t i;
 	jsmntok_t *token;
 #endif
-	int count = parser->toknext;
+	jsmnint_t count = parser->toknext;
 #ifdef JSMN_DOM
-	int dom_i;
+	jsmnint_t dom_i;
 #endif /* JSMN_DOM */
 
 	for (; parser->pos < len && js[parser->pos] != '\0'; parser->pos++) {
 		char c;
 		jsmntype_t type;
 
+#ifdef JSMN_SIMD
+		parser->pos = jsmn_index_next(js, parser->pos, len, JSMN_INDEX_VALUE);
+		if (parser->pos >= len || js[parser->pos] == '\0') {
+			break;
+		}
+#endif
 		c = js[parser->pos];
 		switch (c) {
 			case '{': case '[':
@@ -266,7 +1045,7 @@ int jsmn_parse(jsmn_parser *parser, const char *js, size_t len,
 				if (dom_i < 0) {
 					return dom_i;
 				}
-				dom_i = jsmn_dom_add(parser, tokens, num_tokens, parser->toksuper, dom_i);
+				dom_i = jsmn_dom_link(tokens, num_tokens, parser->toksuper, dom_i);
 				if (dom_i < 0) {
 					return dom_i;
 				}
@@ -276,14 +1055,20 @@ int jsmn_parse(jsmn_parser *parser, const char *js, size_t len,
 				if (token == NULL)
 					return JSMN_ERROR_NOMEM;
 				if (parser->toksuper != -1) {
-					tokens[parser->toksuper].size++;
+					r = jsmn_add_child(&tokens[parser->toksuper]);
+					if (r < 0) return r;
 #ifdef JSMN_PARENT_LINKS
 					token->parent = parser->toksuper;
 #endif /* JSMN_PARENT_LINKS */
 				}
-				token->type = (c == '{' ? JSMN_OBJECT : JSMN_ARRAY);
-				token->start = parser->pos;
+				jsmn_open_token(token, c == '{' ? JSMN_OBJECT : JSMN_ARRAY, parser->pos);
 				parser->toksuper = parser->toknext - 1;
+#ifndef JSMN_PARENT_LINKS
+				if (parser->depth < JSMN_STACK_SIZE) {
+					parser->stack[parser->depth] = parser->toksuper;
+				}
+				parser->depth++;
+#endif /* !JSMN_PARENT_LINKS */
 #endif /* !JSMN_DOM */
 				break;
 			case '}': case ']':
@@ -309,11 +1094,14 @@ int jsmn_parse(jsmn_parser *parser, const char *js, size_t len,
 				}
 				token = &tokens[parser->toknext - 1];
 				for (;;) {
-					if (token->start != -1 && token->end == -1) {
+					if (jsmn_token_is_open(token)) {
 						if (token->type != type) {
 							return JSMN_ERROR_INVAL;
 						}
-						token->end = parser->pos + 1;
+						jsmn_close_token(token, parser->pos + 1);
+#ifdef JSMN_SKIP_LINKS
+						jsmn_skip_links(parser, tokens, token - tokens);
+#endif
 						parser->toksuper = token->parent;
 						break;
 					}
@@ -323,28 +1111,21 @@ int jsmn_parse(jsmn_parser *parser, const char *js, size_t len,
 					token = &tokens[token->parent];
 				}
 #else /* JSMN_PARENT_LINKS */
-				/* Find container's latest open token. Set its `end`. */
-				for (i = parser->toknext - 1; i >= 0; i--) {
-					token = &tokens[i];
-					if (token->start != -1 && token->end == -1) {
-						if (token->type != type) {
-							return JSMN_ERROR_INVAL;
-						}
-						parser->toksuper = -1;
-						token->end = parser->pos + 1;
-						break;
-					}
-				}
+				/* Pop container's latest open token. Set its `end`. */
+				i = jsmn_open_top(parser, tokens);
 				/* Error if unmatched closing bracket */
 				if (i == -1) return JSMN_ERROR_INVAL;
-				/* Find the next latest open token. Set that to the current `toksuper`. */
-				for (; i >= 0; i--) {
-					token = &tokens[i];
-					if (token->start != -1 && token->end == -1) {
-						parser->toksuper = i;
-						break;
-					}
+				token = &tokens[i];
+				if (token->type != type) {
+					return JSMN_ERROR_INVAL;
 				}
+				jsmn_close_token(token, parser->pos + 1);
+#ifdef JSMN_SKIP_LINKS
+				jsmn_skip_links(parser, tokens, i);
+#endif
+				parser->depth--;
+				/* The next latest open token is the current `toksuper`. */
+				parser->toksuper = jsmn_open_top(parser, tokens);
 #endif /* !JSMN_PARENT_LINKS */
 #endif /* !JSMN_DOM */
 				break;
@@ -354,8 +1135,15 @@ int jsmn_parse(jsmn_parser *parser, const char *js, size_t len,
 				count++;
 #ifdef JSMN_DOM
 #else /* JSMN_DOM */
-				if (parser->toksuper != -1 && tokens != NULL)
-					tokens[parser->toksuper].size++;
+				if (parser->toksuper != -1 && tokens != NULL) {
+					r = jsmn_add_child(&tokens[parser->toksuper]);
+					if (r < 0) return r;
+				}
+#ifdef JSMN_SKIP_LINKS
+				if (tokens != NULL) {
+					jsmn_skip_links(parser, tokens, parser->toknext - 1);
+				}
+#endif
 #endif /* !JSMN_DOM */
 				break;
 			case '\t' : case '\r' : case '\n' : case ' ':
@@ -373,13 +1161,9 @@ int jsmn_parse(jsmn_parser *parser, const char *js, size_t len,
 #ifdef JSMN_PARENT_LINKS
 					parser->toksuper = tokens[parser->toksuper].parent;
 #else /* JSMN_PARENT_LINKS */
-					for (i = parser->toknext - 1; i >= 0; i--) {
-						if (tokens[i].type == JSMN_ARRAY || tokens[i].type == JSMN_OBJECT) {
-							if (tokens[i].start != -1 && tokens[i].end == -1) {
-								parser->toksuper = i;
-								break;
-							}
-						}
+					i = jsmn_open_top(parser, tokens);
+					if (i != -1) {
+						parser->toksuper = i;
 					}
 #endif /* !JSMN_PARENT_LINKS */
 #endif /* !JSMN_DOM */
@@ -406,7 +1190,7 @@ int jsmn_parse(jsmn_parser *parser, const char *js, size_t len,
 #else /* JSMN_DOM */
 					jsmntok_t *t = &tokens[parser->toksuper];
 					if (t->type == JSMN_OBJECT ||
-							(t->type == JSMN_STRING && t->size != 0)) {
+							(t->type == JSMN_STRING && JSMN_TOK_SIZE(t) != 0)) {
 						return JSMN_ERROR_INVAL;
 					}
 #endif /* !JSMN_DOM */
@@ -420,8 +1204,15 @@ int jsmn_parse(jsmn_parser *parser, const char *js, size_t len,
 				count++;
 #ifdef JSMN_DOM
 #else /* JSMN_DOM */
-				if (parser->toksuper != -1 && tokens != NULL)
-					tokens[parser->toksuper].size++;
+				if (parser->toksuper != -1 && tokens != NULL) {
+					r = jsmn_add_child(&tokens[parser->toksuper]);
+					if (r < 0) return r;
+				}
+#ifdef JSMN_SKIP_LINKS
+				if (tokens != NULL) {
+					jsmn_skip_links(parser, tokens, parser->toknext - 1);
+				}
+#endif
 #endif /* !JSMN_DOM */
 				break;
 
@@ -439,12 +1230,19 @@ int jsmn_parse(jsmn_parser *parser, const char *js, size_t len,
 			return JSMN_ERROR_PART;
 		}
 #else /* JSMN_DOM */
+#ifdef JSMN_PARENT_LINKS
 		for (i = parser->toknext - 1; i >= 0; i--) {
 			/* Unmatched opened object or array */
-			if (tokens[i].start != -1 && tokens[i].end == -1) {
+			if (jsmn_token_is_open(&tokens[i])) {
 				return JSMN_ERROR_PART;
 			}
 		}
+#else /* JSMN_PARENT_LINKS */
+		/* Unmatched opened object or array */
+		if (parser->depth > 0) {
+			return JSMN_ERROR_PART;
+		}
+#endif /* !JSMN_PARENT_LINKS */
 #endif /* !JSMN_DOM */
 	}
 	
@@ -453,160 +1251,1325 @@ int jsmn_parse(jsmn_parser *parser, const char *js, size_t len,
 }
 
 /**
- * Creates a new parser based over a given  buffer with an array of tokens
- * available.
+ * Parse JSON string, growing the array of tokens as needed.
  */
-void jsmn_init(jsmn_parser *parser) {
-	parser->pos = 0;
-	parser->toknext = 0;
-	parser->toksuper = -1;
-}
-
-#ifdef JSMN_DOM
-int jsmn_dom_rollback(jsmn_parser *parser, jsmntok_t *tokens, unsigned int num_tokens, int i) {
-	if (i == -1 || i >= (int) num_tokens) {
-		return JSMN_ERROR_INVAL;
+jsmnint_t jsmn_parse_ex(jsmn_parser *parser, const char *js, size_t len,
+		jsmntok_t **tokens, jsmnuint_t *num_tokens,
+		jsmn_realloc_t realloc_fn, void *ctx, jsmnuint_t max_tokens) {
+	jsmnint_t r;
+	jsmnuint_t grow;
+	jsmntok_t *grown;
+
+	if (*tokens == NULL) {
+		*num_tokens = 0;
 	}
 
-	parser->pos = tokens[i].start;
-	parser->toknext = i;
+	for (;;) {
+		if (*tokens != NULL) {
+			r = jsmn_parse(parser, js, len, *tokens, *num_tokens);
+			if (r != JSMN_ERROR_NOMEM) {
+				return r;
+			}
+		}
 
-	return i;
-}
-int jsmn_dom_get_value(jsmn_parser *parser, const char *js, size_t len, jsmntok_t *tokens, unsigned int num_tokens, int i, char *buf, size_t buflen) {
-	size_t size;
-	size_t min_size;
+		/* The parser stopped in front of the token that did not fit: make room and resume there. */
+		if (*num_tokens < 16) {
+			grow = 16;
+		} else if (*num_tokens <= ((jsmnuint_t) -1) / 2) {
+			grow = *num_tokens * 2;
+		} else {
+			grow = (jsmnuint_t) -1;
+		}
+		if (max_tokens != 0 && grow > max_tokens) {
+			grow = max_tokens;
+		}
+		if (grow <= *num_tokens || grow * sizeof(jsmntok_t) / sizeof(jsmntok_t) != grow) {
+			return JSMN_ERROR_NOMEM;
+		}
 
-	if (i == -1 || i >= (int) num_tokens || tokens[i].end < tokens[i].start || buflen < 1) {
-		return JSMN_ERROR_INVAL;
+		grown = (jsmntok_t *) realloc_fn(ctx, *tokens, grow * sizeof(jsmntok_t));
+		if (grown == NULL) {
+			return JSMN_ERROR_NOMEM;
+		}
+		*tokens = grown;
+		*num_tokens = grow;
 	}
+}
 
-	size = tokens[i].end - tokens[i].start;
-	min_size = size < buflen - 1 ? size : buflen - 1;
+#ifdef JSMN_SAX
+#define JSMN_SAX_OBJECT(parser, l) (((parser)->sax_objects[(l) / 8] >> ((l) % 8)) & 1)
 
-	our_memcpy(buf, &js[tokens[i].start], min_size);
-	buf[min_size] = '\0';
+/**
+ * Parse JSON string, calling back for every value instead of filling tokens.
+ */
+jsmnint_t jsmn_parse_sax(jsmn_parser *parser, const char *js, size_t len,
+		const jsmn_sax *sax, void *ctx) {
+	jsmnint_t start;
+	unsigned int level;
+	int key;
+	int r;
 
-	return size;
-}
-int jsmn_dom_get_start(jsmn_parser *parser, jsmntok_t *tokens, unsigned int num_tokens, int i) {
-	if (i == -1 || i >= (int) num_tokens) {
-		return 0;
+	for (; parser->pos < len && js[parser->pos] != '\0'; parser->pos++) {
+		char c;
+
+#ifdef JSMN_SIMD
+		parser->pos = jsmn_index_next(js, parser->pos, len, JSMN_INDEX_VALUE);
+		if (parser->pos >= len || js[parser->pos] == '\0') {
+			break;
+		}
+#endif
+		c = js[parser->pos];
+		start = (jsmnint_t) parser->pos;
+		r = 0;
+		switch (c) {
+			case '{': case '[':
+#ifdef JSMN_STRICT
+				/* Objects and arrays are not keys */
+				if (parser->sax_key) {
+					return JSMN_ERROR_INVAL;
+				}
+#endif
+				if (parser->sax_depth >= JSMN_SAX_DEPTH) {
+					return JSMN_ERROR_NOMEM;
+				}
+				level = parser->sax_depth++;
+				if (c == '{') {
+					parser->sax_objects[level / 8] |= (unsigned char) (1 << (level % 8));
+				} else {
+					parser->sax_objects[level / 8] &= (unsigned char) ~(1 << (level % 8));
+				}
+				parser->sax_key = c == '{';
+				parser->toknext++;
+				if (c == '{' && sax->begin_object != NULL) {
+					r = sax->begin_object(ctx, start);
+				} else if (c == '[' && sax->begin_array != NULL) {
+					r = sax->begin_array(ctx, start);
+				}
+				break;
+			case '}': case ']':
+				/* Error if unmatched closing bracket */
+				if (parser->sax_depth == 0 ||
+						JSMN_SAX_OBJECT(parser, parser->sax_depth - 1) != (c == '}')) {
+					return JSMN_ERROR_INVAL;
+				}
+				parser->sax_depth--;
+				parser->sax_key = 0;
+				if (c == '}' && sax->end_object != NULL) {
+					r = sax->end_object(ctx, start + 1);
+				} else if (c == ']' && sax->end_array != NULL) {
+					r = sax->end_array(ctx, start + 1);
+				}
+				break;
+			case '\"':
+				r = jsmn_parse_string(parser, js, len, NULL, 0);
+				if (r < 0) return r;
+				parser->toknext++;
+				key = parser->sax_key;
+				parser->sax_key = 0;
+				if (key && sax->key != NULL) {
+					r = sax->key(ctx, start + 1, (jsmnint_t) parser->pos);
+				} else if (!key && sax->string != NULL) {
+					r = sax->string(ctx, start + 1, (jsmnint_t) parser->pos);
+				}
+				break;
+			case '\t' : case '\r' : case '\n' : case ' ':
+				break;
+			case ':':
+				parser->sax_key = 0;
+				break;
+			case ',':
+				parser->sax_key = parser->sax_depth > 0 && JSMN_SAX_OBJECT(parser, parser->sax_depth - 1);
+				break;
+#ifdef JSMN_STRICT
+			/* In strict mode primitives are: numbers and booleans */
+			case '-': case '0': case '1' : case '2': case '3' : case '4':
+			case '5': case '6': case '7' : case '8': case '9':
+			case 't': case 'f': case 'n' :
+				/* And they must not be keys of the object */
+				if (parser->sax_key) {
+					return JSMN_ERROR_INVAL;
+				}
+#else /* JSMN_STRICT */
+			/* In non-strict mode every unquoted value is a primitive */
+			default:
+#endif /* !JSMN_STRICT */
+				r = jsmn_parse_primitive(parser, js, len, NULL, 0);
+				if (r < 0) return r;
+				parser->toknext++;
+				key = parser->sax_key;
+				parser->sax_key = 0;
+				if (key && sax->key != NULL) {
+					r = sax->key(ctx, start, (jsmnint_t) parser->pos + 1);
+				} else if (!key && sax->primitive != NULL) {
+					r = sax->primitive(ctx, start, (jsmnint_t) parser->pos + 1);
+				}
+				break;
+
+#ifdef JSMN_STRICT
+			/* Unexpected char in strict mode */
+			default:
+				return JSMN_ERROR_INVAL;
+#endif /* JSMN_STRICT */
+		}
+		if (r != 0) {
+			/* Stopped by a callback: resume after this value */
+			parser->pos++;
+			parser->sax_stop = r;
+			return JSMN_ERROR_STOPPED;
+		}
 	}
 
-	if (tokens[i].start >= 0) {
-		return tokens[i].start;
-	} else {
-		return 0;
+	/* Unmatched opened object or array */
+	if (parser->sax_depth > 0) {
+		return JSMN_ERROR_PART;
 	}
+	return (jsmnint_t) parser->toknext;
 }
-size_t jsmn_dom_get_strlen(jsmn_parser *parser, jsmntok_t *tokens, unsigned int num_tokens, int i) {
-	if (i == -1 || i >= (int) num_tokens) {
-		return 0;
+#endif
+
+/**
+ * Creates a new parser based over a given  buffer with an array of tokens
+ * available.
+ */
+void jsmn_init(jsmn_parser *parser) {
+	parser->pos = 0;
+	parser->toknext = 0;
+	parser->toksuper = -1;
+#if !defined(JSMN_DOM) && !defined(JSMN_PARENT_LINKS)
+	parser->depth = 0;
+#endif
+#ifdef JSMN_SAX
+	parser->sax_depth = 0;
+	parser->sax_key = 0;
+	parser->sax_stop = 0;
+#endif
+#ifdef JSMN_DOM
+	parser->indexes = NULL;
+	parser->cache = NULL;
+	parser->num_cache = 0;
+#endif
+}
+
+/*
+ * Seeded 32-bit FNV-1a, the same on every platform.
+ */
+static unsigned long jsmn_keyset_hash(unsigned long seed, const char *key, size_t len) {
+	unsigned long h = (2166136261UL ^ seed) & 0xffffffffUL;
+
+	while (len-- > 0) {
+		h = ((h ^ (unsigned char) *key++) * 16777619UL) & 0xffffffffUL;
 	}
+	return h ^ (h >> 15);
+}
 
-	if (tokens[i].end >= tokens[i].start) {
-		return tokens[i].end - tokens[i].start;
-	} else {
-		return 0;
+static size_t jsmn_keyset_strlen(const char *key) {
+	size_t len = 0;
+
+	while (key[len] != '\0') {
+		len++;
 	}
+	return len;
 }
-size_t jsmn_dom_get_count(jsmn_parser *parser, jsmntok_t *tokens, unsigned int num_tokens, int i) {
-	size_t count;
-	int dom_i;
 
-	if (i == -1 || i >= (int) num_tokens) {
-		return 0;
+static int jsmn_keyset_equal(const char *a, const char *b, size_t len) {
+	while (len-- > 0) {
+		if (*a++ != *b++) {
+			return 0;
+		}
 	}
+	return 1;
+}
 
-	count = 0;
+int jsmn_keyset_init(jsmn_keyset *keyset, const char *const *keys, unsigned int num_keys,
+		unsigned char *slots, unsigned int num_slots, unsigned long seed) {
+	unsigned long tries;
+	unsigned long slot;
+	unsigned int i;
+	unsigned int j;
+	size_t len;
 
-	dom_i = jsmn_dom_get_child(parser, tokens, num_tokens, i);
-	while (dom_i != -1) {
-		count++;
-		dom_i = jsmn_dom_get_sibling(parser, tokens, num_tokens, dom_i);
+	if (num_keys > 255 || num_keys > num_slots || num_slots == 0 || (num_slots & (num_slots - 1)) != 0) {
+		return JSMN_ERROR_INVAL;
 	}
 
-	return count;
-}
-jsmntype_t jsmn_dom_get_type(jsmn_parser *parser, jsmntok_t *tokens, unsigned int num_tokens, int i) {
-	if (i == -1 || i >= (int) num_tokens) {
-		return JSMN_UNDEFINED;
+	for (tries = 0; tries < 65536; tries++, seed = (seed + 1) & 0xffffffffUL) {
+		for (j = 0; j < num_slots; j++) {
+			slots[j] = 0;
+		}
+		for (i = 0; i < num_keys; i++) {
+			len = jsmn_keyset_strlen(keys[i]);
+			slot = jsmn_keyset_hash(seed, keys[i], len) & (num_slots - 1);
+			if (slots[slot] != 0) {
+				j = slots[slot] - 1;
+				if (jsmn_keyset_strlen(keys[j]) == len && jsmn_keyset_equal(keys[j], keys[i], len)) {
+					return JSMN_ERROR_INVAL;
+				}
+				break;
+			}
+			slots[slot] = (unsigned char) (i + 1);
+		}
+		if (i == num_keys) {
+			keyset->keys = keys;
+			keyset->num_keys = num_keys;
+			keyset->seed = seed;
+			keyset->slots = slots;
+			keyset->num_slots = num_slots;
+			return 0;
+		}
 	}
 
-	return tokens[i].type;
+	return JSMN_ERROR_NOMEM;
 }
-int jsmn_dom_get_parent(jsmn_parser *parser, jsmntok_t *tokens, unsigned int num_tokens, int i) {
-	if (i == -1 || i >= (int) num_tokens) {
+
+int jsmn_keyset_match(const jsmn_keyset *keyset, const char *key, size_t len) {
+	unsigned int slot;
+	const char *candidate;
+
+	slot = keyset->slots[jsmn_keyset_hash(keyset->seed, key, len) & (keyset->num_slots - 1)];
+	if (slot == 0) {
 		return -1;
 	}
 
-	return tokens[i].family.parent;
-}
-int jsmn_dom_get_child(jsmn_parser *parser, jsmntok_t *tokens, unsigned int num_tokens, int i) {
-	if (i == -1 || i >= (int) num_tokens) {
+	/* The one key that hashes there: its length ends where `key` does */
+	candidate = keyset->keys[slot - 1];
+	if (!jsmn_keyset_equal(candidate, key, len) || candidate[len] != '\0') {
 		return -1;
 	}
-
-	return tokens[i].family.children.first;
+	return (int) slot - 1;
 }
-int jsmn_dom_get_sibling(jsmn_parser *parser, jsmntok_t *tokens, unsigned int num_tokens, int i) {
-	if (i == -1 || i >= (int) num_tokens) {
+
+int jsmn_keyset_token(const jsmn_keyset *keyset, const char *js, const jsmntok_t *tok) {
+	if (JSMN_TOK_TYPE(tok) != JSMN_STRING) {
 		return -1;
 	}
-
-	return tokens[i].family.siblings.next;
+	return jsmn_keyset_match(keyset, js + JSMN_TOK_START(tok), JSMN_TOK_LEN(tok));
 }
-int jsmn_dom_is_open(jsmn_parser *parser, jsmntok_t *tokens, unsigned int num_tokens, int i) {
-	if (i == -1 || i >= (int) num_tokens) {
-		return 0;
-	}
 
-	return tokens[i].start != -1 && tokens[i].end == -1;
-}
-int jsmn_dom_get_open(jsmn_parser *parser, jsmntok_t *tokens, unsigned int num_tokens, int i) {
-	if (i == -1 || i >= (int) num_tokens) {
-		return 0;
+#ifdef JSMN_SIMD
+/**
+ * Counts the tokens of a JSON data string a 64-byte block at a time.
+ */
+jsmnint_t jsmn_count_tokens(const char *js, size_t len, unsigned int *depth) {
+	struct jsmn_block b;
+	char tail[64];
+	size_t pos;
+	size_t i;
+	unsigned long long escaped_carry;
+	unsigned long long string_carry;
+	unsigned long long value_carry;
+	unsigned long long quote;
+	unsigned long long string;
+	unsigned long long value;
+	unsigned long long nesting;
+	unsigned long long valid;
+	jsmnint_t count;
+	int level;
+	int max_level;
+
+	escaped_carry = 0;
+	string_carry  = 0;
+	value_carry   = 0;
+	count         = 0;
+	level         = 0;
+	max_level     = 0;
+
+	for (pos = 0; pos < len; pos += 64) {
+		if (pos + 64 <= len) {
+			jsmn_index_block(js + pos, &b);
+		} else {
+			/* pad the last block with whitespace */
+			for (i = 0; i < 64; i++) {
+				tail[i] = pos + i < len ? js[pos + i] : ' ';
+			}
+			jsmn_index_block(tail, &b);
+		}
+
+		/* the parser stops at a null terminator */
+		valid = b.nul == 0 ? ~0ULL : (b.nul & -b.nul) - 1;
+
+		/* string bits run from an opening quote up to its closing quote */
+		quote  = b.quote & ~jsmn_index_escaped(b.backslash, &escaped_carry);
+		string = jsmn_index_prefix_xor(quote) ^ string_carry;
+		string_carry = (unsigned long long) 0 - (string >> 63);
+
+		/* containers, strings, and primitives from their first byte */
+		value = ~(string | quote | b.open | b.close | b.delimiter) & valid;
+		count += jsmn_popcount((b.open & ~string) & valid);
+		count += jsmn_popcount((quote & string) & valid);
+		count += jsmn_popcount(value & ~(value << 1 | value_carry));
+		value_carry = value >> 63;
+
+		nesting = (b.open | b.close) & ~string & valid;
+		while (nesting != 0) {
+			if (b.open & nesting & -nesting) {
+				level++;
+				if (level > max_level) {
+					max_level = level;
+				}
+			} else if (level > 0) {
+				level--;
+			}
+			nesting &= nesting - 1;
+		}
+
+		if (b.nul != 0) {
+			break;
+		}
 	}
 
-	while (i != -1 && ! jsmn_dom_is_open(parser, tokens, num_tokens, i)) {
-		i = jsmn_dom_get_parent(parser, tokens, num_tokens, i);
+	if (depth != NULL) {
+		*depth = max_level;
 	}
 
-	return i;
+	return count;
 }
-int jsmn_dom_add(jsmn_parser *parser, jsmntok_t *tokens, unsigned int num_tokens, int parent_i, int i) {
-	if (i == -1 || i >= (int) num_tokens || parent_i >= (int) num_tokens) {
+#endif
+
+#ifdef JSMN_THREADS
+/*
+ * Parallel parsing.
+ * 1. The document is cut into one chunk per thread, and every chunk counts its unquoted '"'. A prefix
+ *    parity over the counts tells whether each chunk starts inside a string.
+ * 2. Every chunk moves its start right past the first ',', '{' or '[' outside of a string, and tokenizes
+ *    up to the next chunk's start into a private buffer. Containers opened before the chunk are
+ *    "external": they are referenced by nesting level (JSMN_EXT), and closing them is recorded.
+ * 3. The chunks are stitched in order, resolving the external levels to token indices, and checked for
+ *    anything the speculative chunk parse could have got wrong. On any doubt, jsmn_parse() takes over.
+ * 4. Every chunk copies its tokens into place, and the external sizes and ends are fixed up.
+ */
+#include <pthread.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#ifndef JSMN_THREADS_MIN_CHUNK
+#define JSMN_THREADS_MIN_CHUNK (1 << 20)
+#endif
+
+/* Reference to the container `l` levels outside of the chunk; 0 is the innermost */
+#define JSMN_EXT(l)       (-2 - (jsmnint_t) (l))
+#define JSMN_EXT_LEVEL(s) ((jsmnuint_t) (-2 - (s)))
+
+/* Checks on an external container that need to know what it is */
+#define JSMN_EXT_PRIMITIVE 1 /* primitive value: must not be an object in strict mode */
+#define JSMN_EXT_COMMA     2 /* ',' fell back to it: must not be the top level */
+
+struct jsmn_level {
+	jsmnint_t size;    /* children added in the chunk */
+	jsmntype_t type;   /* type of the bracket closing it, if closed in the chunk */
+	jsmnint_t end;     /* end of the container, if closed in the chunk */
+	jsmnuint_t next;   /* chunk tokens allocated when it was closed */
+	int flags;
+};
+
+struct jsmn_chunk {
+	const char *js;
+	size_t len;        /* whole document */
+	size_t start;      /* nominal start, then start right after a ',', '{' or '[' */
+	size_t stop;       /* start of the next chunk */
+	int phase;
+	int quotes;        /* odd number of unescaped quotes */
+	int in_string;
+	int nul;
+	int status;
+
+	jsmn_parser parser;
+	jsmntok_t *tokens;
+	jsmnuint_t num_tokens;
+	jsmnint_t *open;   /* containers opened and still open in the chunk */
+	jsmnuint_t num_open;
+	jsmnuint_t open_cap;
+	struct jsmn_level *levels; /* external containers, pops + 1 of them */
+	jsmnuint_t pops;
+	jsmnuint_t level_cap;
+
+	jsmnint_t base;    /* index of the first chunk token in the result */
+	jsmnint_t *map;    /* external level to token index, or -1 */
+	jsmntok_t *out;
+};
+
+static int jsmn_chunk_grow(void **ptr, jsmnuint_t *cap, size_t size) {
+	jsmnuint_t grow = *cap < 16 ? 16 : *cap * 2;
+	void *grown = realloc(*ptr, grow * size);
+	if (grown == NULL) {
+		return JSMN_ERROR_NOMEM;
+	}
+	*ptr = grown;
+	*cap = grow;
+	return 0;
+}
+
+/**
+ * Returns the innermost open container of a chunk.
+ */
+static jsmnint_t jsmn_chunk_top(struct jsmn_chunk *c) {
+	return c->num_open > 0 ? c->open[c->num_open - 1] : JSMN_EXT(c->pops);
+}
+
+/**
+ * Counts a child of a chunk token or of an external container.
+ */
+static int jsmn_chunk_child(struct jsmn_chunk *c, jsmnint_t i) {
+	if (i >= 0) {
+		return jsmn_add_child(&c->tokens[i]);
+	}
+	c->levels[JSMN_EXT_LEVEL(i)].size++;
+	return 0;
+}
+
+/**
+ * Finds the first position after a ',', '{' or '[' outside of a string.
+ */
+static size_t jsmn_chunk_safe(const char *js, size_t pos, size_t len, int in_string) {
+	int escaped = 0;
+
+	for (; pos < len; pos++) {
+		if (in_string) {
+			if (escaped) {
+				escaped = 0;
+			} else if (js[pos] == '\\') {
+				escaped = 1;
+			} else if (js[pos] == '\"') {
+				in_string = 0;
+			}
+		} else if (js[pos] == '\"') {
+			in_string = 1;
+		} else if (js[pos] == ',' || js[pos] == '{' || js[pos] == '[') {
+			return pos + 1;
+		}
+	}
+	return len;
+}
+
+/**
+ * Counts the unescaped quotes of a chunk, whose first byte is not escaped.
+ */
+static void jsmn_chunk_quotes(struct jsmn_chunk *c) {
+	const char *js = c->js;
+	size_t pos;
+	int escaped = 0;
+
+	c->quotes = 0;
+	c->nul = 0;
+	for (pos = c->start; pos < c->stop; pos++) {
+		if (escaped) {
+			escaped = 0;
+		} else if (js[pos] == '\\') {
+			escaped = 1;
+		} else if (js[pos] == '\"') {
+			c->quotes ^= 1;
+		}
+		if (js[pos] == '\0') {
+			c->nul = 1;
+		}
+	}
+}
+
+/**
+ * Tokenizes a chunk like jsmn_parse() would, relative to the containers open at its start.
+ * Returns 0, or an error when the chunk cannot be parsed on its own.
+ */
+static int jsmn_chunk_parse(struct jsmn_chunk *c) {
+	jsmn_parser *parser = &c->parser;
+	const char *js = c->js;
+	size_t len = c->stop;
+	size_t structural = (size_t) -1;
+	jsmntok_t *token;
+	jsmntype_t type;
+	jsmnint_t i;
+	int r;
+
+	jsmn_init(parser);
+	parser->pos = c->start;
+	parser->toksuper = JSMN_EXT(0);
+	c->num_open = 0;
+	c->pops = 0;
+	if (c->level_cap < 1 && jsmn_chunk_grow((void **) &c->levels, &c->level_cap, sizeof(*c->levels)) < 0) {
+		return JSMN_ERROR_NOMEM;
+	}
+	c->levels[0].size = 0;
+	c->levels[0].flags = 0;
+
+	for (; parser->pos < len; parser->pos++) {
+#ifdef JSMN_SIMD
+		parser->pos = jsmn_index_next(js, parser->pos, len, JSMN_INDEX_VALUE);
+		if (parser->pos >= len) {
+			break;
+		}
+#endif
+		if (parser->toknext >= c->num_tokens && jsmn_chunk_grow((void **) &c->tokens, &c->num_tokens, sizeof(jsmntok_t)) < 0) {
+			return JSMN_ERROR_NOMEM;
+		}
+
+		switch (js[parser->pos]) {
+			case '{': case '[':
+				if (c->num_open >= c->open_cap && jsmn_chunk_grow((void **) &c->open, &c->open_cap, sizeof(*c->open)) < 0) {
+					return JSMN_ERROR_NOMEM;
+				}
+				token = jsmn_alloc_token(parser, c->tokens, c->num_tokens);
+				r = jsmn_chunk_child(c, parser->toksuper);
+				if (r < 0) return r;
+#ifdef JSMN_PARENT_LINKS
+				token->parent = parser->toksuper;
+#endif
+				jsmn_open_token(token, js[parser->pos] == '{' ? JSMN_OBJECT : JSMN_ARRAY, parser->pos);
+				parser->toksuper = parser->toknext - 1;
+				c->open[c->num_open++] = parser->toksuper;
+				structural = parser->pos;
+				break;
+			case '}': case ']':
+				type = (js[parser->pos] == '}' ? JSMN_OBJECT : JSMN_ARRAY);
+#ifdef JSMN_PARENT_LINKS
+				/* jsmn_parse() closes the first open ancestor of the latest token: the innermost container */
+				i = parser->toknext > 0 ? (jsmnint_t) parser->toknext - 1 : JSMN_EXT(c->pops);
+				while (i >= 0 && ! jsmn_token_is_open(&c->tokens[i])) {
+					i = c->tokens[i].parent;
+				}
+				if (i < 0 && JSMN_EXT_LEVEL(i) < c->pops) {
+					/* Closed in the chunk: stitching checks that it leads to the next level */
+					i = JSMN_EXT(c->pops);
+				}
+				if (i != jsmn_chunk_top(c)) {
+					return JSMN_ERROR_INVAL;
+				}
+#endif
+				if (c->num_open > 0) {
+					i = c->open[--c->num_open];
+					token = &c->tokens[i];
+					if (token->type != type) {
+						return JSMN_ERROR_INVAL;
+					}
+					jsmn_close_token(token, parser->pos + 1);
+#ifdef JSMN_SKIP_LINKS
+					jsmn_skip_links(parser, c->tokens, i);
+#endif
+#ifdef JSMN_PARENT_LINKS
+					parser->toksuper = token->parent;
+#else
+					parser->toksuper = jsmn_chunk_top(c);
+#endif
+					break;
+				}
+
+				/* Closes a container opened before the chunk */
+				if (c->pops + 1 >= c->level_cap && jsmn_chunk_grow((void **) &c->levels, &c->level_cap, sizeof(*c->levels)) < 0) {
+					return JSMN_ERROR_NOMEM;
+				}
+				c->levels[c->pops].type = type;
+				c->levels[c->pops].end = parser->pos + 1;
+				c->levels[c->pops].next = parser->toknext;
+				c->pops++;
+				c->levels[c->pops].size = 0;
+				c->levels[c->pops].flags = 0;
+				parser->toksuper = JSMN_EXT(c->pops);
+#ifdef JSMN_PARENT_LINKS
+				/* jsmn_parse() would now point at the container's parent, which may be its key */
+				for (i = parser->pos + 1; (size_t) i < len; i++) {
+					if (js[i] != ' ' && js[i] != '\t' && js[i] != '\r' && js[i] != '\n') {
+						break;
+					}
+				}
+				if ((size_t) i < len && js[i] != ',' && js[i] != '}' && js[i] != ']') {
+					return JSMN_ERROR_INVAL;
+				}
+#endif
+				break;
+			case '\"':
+				r = jsmn_parse_string(parser, js, len, c->tokens, c->num_tokens);
+				if (r < 0) return r;
+				r = jsmn_chunk_child(c, parser->toksuper);
+				if (r < 0) return r;
+#ifdef JSMN_SKIP_LINKS
+				jsmn_skip_links(parser, c->tokens, parser->toknext - 1);
+#endif
+				break;
+			case '\t' : case '\r' : case '\n' : case ' ':
+				break;
+			case ':':
+				if (parser->toknext == 0) {
+					return JSMN_ERROR_INVAL;
+				}
+				parser->toksuper = parser->toknext - 1;
+				if (c->tokens[parser->toksuper].type == JSMN_OBJECT || c->tokens[parser->toksuper].type == JSMN_ARRAY) {
+					return JSMN_ERROR_INVAL;
+				}
+				break;
+			case ',':
+				if (parser->toksuper >= 0 &&
+						c->tokens[parser->toksuper].type != JSMN_ARRAY &&
+						c->tokens[parser->toksuper].type != JSMN_OBJECT) {
+#ifdef JSMN_PARENT_LINKS
+					parser->toksuper = c->tokens[parser->toksuper].parent;
+#else
+					parser->toksuper = jsmn_chunk_top(c);
+					if (parser->toksuper < 0) {
+						c->levels[JSMN_EXT_LEVEL(parser->toksuper)].flags |= JSMN_EXT_COMMA;
+					}
+#endif
+				}
+				structural = parser->pos;
+				break;
+#ifdef JSMN_STRICT
+			case '-': case '0': case '1' : case '2': case '3' : case '4':
+			case '5': case '6': case '7' : case '8': case '9':
+			case 't': case 'f': case 'n' :
+				if (parser->toksuper >= 0) {
+					token = &c->tokens[parser->toksuper];
+					if (token->type == JSMN_OBJECT ||
+							(token->type == JSMN_STRING && JSMN_TOK_SIZE(token) != 0)) {
+						return JSMN_ERROR_INVAL;
+					}
+				} else {
+					c->levels[JSMN_EXT_LEVEL(parser->toksuper)].flags |= JSMN_EXT_PRIMITIVE;
+				}
+#else
+			default:
+#endif
+				r = jsmn_parse_primitive(parser, js, len, c->tokens, c->num_tokens);
+				if (r < 0) return r;
+				r = jsmn_chunk_child(c, parser->toksuper);
+				if (r < 0) return r;
+#ifdef JSMN_SKIP_LINKS
+				jsmn_skip_links(parser, c->tokens, parser->toknext - 1);
+#endif
+				break;
+#ifdef JSMN_STRICT
+			default:
+				return JSMN_ERROR_INVAL;
+#endif
+		}
+	}
+
+	/* The next chunk starts right after a ',', '{' or '[', with the innermost container as `toksuper` */
+	if (c->stop < c->len && c->start < c->stop && (structural != c->stop - 1 || parser->toksuper != jsmn_chunk_top(c))) {
 		return JSMN_ERROR_INVAL;
 	}
+	return 0;
+}
 
-	tokens[i].family.parent = parent_i;
-	if (parent_i != -1) {
-		if (    tokens[parent_i].family.children.first == -1) {
-			tokens[parent_i].family.children.first = i;
-			tokens[parent_i].family.children.last  = i;
+#ifdef JSMN_PARENT_LINKS
+/**
+ * Returns the container above token `i` of chunk `c`, past its key, as a result index.
+ */
+static jsmnint_t jsmn_chunk_container(struct jsmn_chunk *c, jsmnint_t i) {
+	jsmnint_t p = c->tokens[i].parent;
+
+	if (p >= 0 && c->tokens[p].type == JSMN_STRING) {
+		p = c->tokens[p].parent;
+	}
+	return p >= 0 ? c->base + p : c->map[JSMN_EXT_LEVEL(p)];
+}
+#endif
+
+/**
+ * Copies the tokens of a chunk into place.
+ */
+static void jsmn_chunk_copy(struct jsmn_chunk *c) {
+	jsmntok_t *out = c->out + c->base;
+	jsmnuint_t i;
+
+	for (i = 0; i < c->parser.toknext; i++) {
+		out[i] = c->tokens[i];
+#ifdef JSMN_PARENT_LINKS
+		if (out[i].parent >= 0) {
+			out[i].parent += c->base;
 		} else {
-			tokens[i].family.siblings.prev = tokens[parent_i].family.children.last;
-			tokens[tokens[parent_i].family.children.last].family.siblings.next = i;
-			tokens[parent_i].family.children.last  = i;
+			out[i].parent = c->map[JSMN_EXT_LEVEL(out[i].parent)];
+		}
+#endif
+#ifdef JSMN_SKIP_LINKS
+		out[i].skip += c->base;
+#endif
+	}
+}
+
+static void *jsmn_chunk_run(void *arg) {
+	struct jsmn_chunk *c = (struct jsmn_chunk *) arg;
+
+	switch (c->phase) {
+		case 1:
+			jsmn_chunk_quotes(c);
+			break;
+		case 2:
+			c->status = jsmn_chunk_parse(c);
+			break;
+		case 3:
+			jsmn_chunk_copy(c);
+			break;
+	}
+	return NULL;
+}
+
+/**
+ * Runs a phase on every chunk, the first one on the calling thread.
+ */
+static void jsmn_chunks_run(struct jsmn_chunk *chunks, unsigned int n, int phase) {
+	pthread_t threads[64];
+	int started[64];
+	unsigned int k;
+
+	for (k = 0; k < n; k++) {
+		chunks[k].phase = phase;
+	}
+	for (k = 1; k < n; k++) {
+		started[k] = pthread_create(&threads[k], NULL, jsmn_chunk_run, &chunks[k]) == 0;
+		if (!started[k]) {
+			jsmn_chunk_run(&chunks[k]);
+		}
+	}
+	jsmn_chunk_run(&chunks[0]);
+	for (k = 1; k < n; k++) {
+		if (started[k]) {
+			pthread_join(threads[k], NULL);
+		}
+	}
+}
+
+/**
+ * Resolves the external levels of every chunk, in document order, and checks them.
+ * Returns the number of tokens, or an error if jsmn_parse() has to parse the document.
+ */
+static jsmnint_t jsmn_chunks_stitch(struct jsmn_chunk *chunks, unsigned int n, jsmnuint_t num_tokens) {
+	struct jsmn_open {
+		jsmnint_t i;           /* result index */
+		jsmntype_t type;
+		struct jsmn_chunk *c;  /* chunk that opened it */
+		jsmnint_t local;       /* chunk token index */
+	} *stack = NULL;
+	struct jsmn_open *o;
+	jsmnuint_t depth = 0;
+	jsmnuint_t cap = 0;
+	jsmnuint_t base = 0;
+	jsmnuint_t l;
+	jsmnuint_t j;
+	unsigned int k;
+	struct jsmn_chunk *c;
+	jsmnint_t r = JSMN_ERROR_INVAL;
+
+	for (k = 0; k < n; k++) {
+		c = &chunks[k];
+		if (c->status < 0 || c->pops > depth) {
+			goto out;
+		}
+		c->base = base;
+		c->map = (jsmnint_t *) malloc((c->pops + 1) * sizeof(*c->map));
+		if (c->map == NULL) {
+			goto out;
+		}
+		for (l = 0; l <= c->pops; l++) {
+			c->map[l] = l < depth ? stack[depth - 1 - l].i : -1;
+		}
+		for (l = 0; l <= c->pops; l++) {
+			o = l < depth ? &stack[depth - 1 - l] : NULL;
+			if (l < c->pops && o->type != c->levels[l].type) {
+				goto out;
+			}
+#ifdef JSMN_PARENT_LINKS
+			/* The chunk went from a closed container to the next level up */
+			if (l < c->pops && jsmn_chunk_container(o->c, o->local) != c->map[l + 1]) {
+				goto out;
+			}
+#endif
+			if ((c->levels[l].flags & JSMN_EXT_PRIMITIVE) && o != NULL && o->type == JSMN_OBJECT) {
+				goto out;
+			}
+			if ((c->levels[l].flags & JSMN_EXT_COMMA) && o == NULL) {
+				goto out;
+			}
+		}
+		depth -= c->pops;
+		for (j = 0; j < c->num_open; j++) {
+			if (depth >= cap && jsmn_chunk_grow((void **) &stack, &cap, sizeof(*stack)) < 0) {
+				goto out;
+			}
+			stack[depth].i = base + c->open[j];
+			stack[depth].type = (jsmntype_t) c->tokens[c->open[j]].type;
+			stack[depth].c = c;
+			stack[depth].local = c->open[j];
+			depth++;
+		}
+		base += c->parser.toknext;
+		if (base > num_tokens) {
+			goto out;
+		}
+	}
+	if (depth == 0) {
+		r = base;
+	}
+
+out:
+	free(stack);
+	return r;
+}
+
+/**
+ * Adds the sizes and ends of the external containers of every chunk.
+ */
+static void jsmn_chunks_fixup(struct jsmn_chunk *chunks, unsigned int n, jsmntok_t *tokens) {
+	struct jsmn_chunk *c;
+	jsmnint_t g;
+	jsmnuint_t l;
+	unsigned int k;
+
+	for (k = 0; k < n; k++) {
+		c = &chunks[k];
+		for (l = 0; l <= c->pops; l++) {
+			g = c->map[l];
+			if (g == -1) {
+				continue;
+			}
+#ifdef JSMN_COMPACT
+			tokens[g].count += c->levels[l].size;
+#else
+			tokens[g].size += c->levels[l].size;
+#endif
+			if (l < c->pops) {
+				jsmn_close_token(&tokens[g], c->levels[l].end);
+#ifdef JSMN_SKIP_LINKS
+				tokens[g].skip = c->base + c->levels[l].next;
+				if (g > 0 && tokens[g - 1].type != JSMN_OBJECT && tokens[g - 1].type != JSMN_ARRAY && tokens[g - 1].size == 1) {
+					tokens[g - 1].skip = tokens[g].skip;
+				}
+#endif
+			}
+		}
+	}
+}
+
+/**
+ * Parse JSON string on several threads.
+ */
+jsmnint_t jsmn_parse_parallel(jsmn_parser *parser, const char *js, size_t len,
+		jsmntok_t *tokens, jsmnuint_t num_tokens, unsigned int nthreads) {
+	struct jsmn_chunk chunks[64];
+	struct jsmn_chunk *c;
+	unsigned int n;
+	unsigned int k;
+	int in_string;
+	jsmnint_t r;
+
+	if (nthreads == 0) {
+		long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+		nthreads = cpus > 0 ? (unsigned int) cpus : 1;
+	}
+	n = nthreads < 64 ? nthreads : 64;
+	if (len / JSMN_THREADS_MIN_CHUNK < n) {
+		n = (unsigned int) (len / JSMN_THREADS_MIN_CHUNK);
+	}
+	if (n < 2 || tokens == NULL || parser->pos != 0 || parser->toknext != 0 || parser->toksuper != -1) {
+		return jsmn_parse(parser, js, len, tokens, num_tokens);
+	}
+
+	/* Chunks start at nominal offsets, moved so that their first byte is not escaped */
+	for (k = 0; k < n; k++) {
+		c = &chunks[k];
+		c->js = js;
+		c->len = len;
+		c->start = len / n * k;
+		if (k > 0 && c->start < chunks[k - 1].start) {
+			c->start = chunks[k - 1].start;
+		}
+		while (c->start > 0 && c->start < len && js[c->start - 1] == '\\') {
+			c->start++;
+		}
+		c->tokens = NULL;
+		c->num_tokens = 0;
+		c->open = NULL;
+		c->open_cap = 0;
+		c->levels = NULL;
+		c->level_cap = 0;
+		c->map = NULL;
+		c->out = tokens;
+		c->status = 0;
+	}
+	for (k = 0; k < n; k++) {
+		chunks[k].stop = k + 1 < n ? chunks[k + 1].start : len;
+	}
+
+	jsmn_chunks_run(chunks, n, 1);
+
+	in_string = 0;
+	for (k = 0; k < n; k++) {
+		if (chunks[k].nul) {
+			/* jsmn_parse() stops at the first '\0' */
+			r = JSMN_ERROR_INVAL;
+			goto out;
+		}
+		chunks[k].in_string = in_string;
+		in_string ^= chunks[k].quotes;
+	}
+
+	/* Chunks start after their first ',', '{' or '[', and end where the next one starts */
+	for (k = 1; k < n; k++) {
+		chunks[k].start = jsmn_chunk_safe(js, chunks[k].start, len, chunks[k].in_string);
+		chunks[k - 1].stop = chunks[k].start;
+	}
+	chunks[n - 1].stop = len;
+
+	jsmn_chunks_run(chunks, n, 2);
+
+	r = jsmn_chunks_stitch(chunks, n, num_tokens);
+	if (r < 0) {
+		goto out;
+	}
+
+	jsmn_chunks_run(chunks, n, 3);
+	jsmn_chunks_fixup(chunks, n, tokens);
+
+	/* The parser state is the one after the last chunk that has any input */
+	for (k = n - 1; k > 0 && chunks[k].start == chunks[k].stop; k--) {
+		/* empty */
+	}
+	c = &chunks[k];
+	parser->pos = len;
+	parser->toknext = r;
+	if (c->parser.toksuper >= 0) {
+		parser->toksuper = c->base + c->parser.toksuper;
+	} else {
+		parser->toksuper = c->map[JSMN_EXT_LEVEL(c->parser.toksuper)];
+	}
+
+out:
+	for (k = 0; k < n; k++) {
+		free(chunks[k].tokens);
+		free(chunks[k].open);
+		free(chunks[k].levels);
+		free(chunks[k].map);
+	}
+	if (r < 0) {
+		return jsmn_parse(parser, js, len, tokens, num_tokens);
+	}
+	return r;
+}
+
+/*
+ * NDJSON batches: lines are found on the calling thread, then the workers take records in batches of
+ * JSMN_NDJSON_BATCH, first to count their tokens, then, once the arena is laid out, to parse them.
+ */
+#ifndef JSMN_NDJSON_BATCH
+#define JSMN_NDJSON_BATCH 64
+#endif
+
+struct jsmn_ndjson {
+	const char *js;
+	jsmntok_t *tokens;
+	jsmn_record *records;
+	jsmnuint_t num_records;
+	jsmnuint_t next;   /* first record no worker took yet */
+	pthread_mutex_t lock;
+};
+
+/**
+ * Returns the offset of the next '\n' at or after `pos`, or `len`.
+ */
+static size_t jsmn_ndjson_eol(const char *js, size_t pos, size_t len) {
+#ifdef JSMN_SIMD
+	return jsmn_index_next(js, pos, len, JSMN_INDEX_LINE);
+#else
+	while (pos < len && js[pos] != '\n') {
+		pos++;
+	}
+	return pos;
+#endif
+}
+
+/**
+ * Returns whether the line from `pos` to `eol` holds anything but whitespace.
+ */
+static int jsmn_ndjson_blank(const char *js, size_t pos, size_t eol) {
+#ifdef JSMN_SIMD
+	return jsmn_index_next(js, pos, eol, JSMN_INDEX_VALUE) == eol;
+#else
+	for (; pos < eol; pos++) {
+		if (js[pos] != ' ' && js[pos] != '\t' && js[pos] != '\r') {
+			return 0;
+		}
+	}
+	return 1;
+#endif
+}
+
+static void *jsmn_ndjson_realloc(void *ctx, void *ptr, size_t size) {
+	(void) ctx;
+	return realloc(ptr, size);
+}
+
+static void *jsmn_ndjson_run(void *arg) {
+	struct jsmn_ndjson *b = (struct jsmn_ndjson *) arg;
+	jsmn_record *rec;
+	jsmn_parser parser;
+	jsmntok_t *scratch = NULL;
+	jsmnuint_t num_scratch = 0;
+	jsmnuint_t i;
+	jsmnuint_t end;
+
+	for (;;) {
+		pthread_mutex_lock(&b->lock);
+		i = b->next;
+		b->next = i + JSMN_NDJSON_BATCH < b->num_records ? i + JSMN_NDJSON_BATCH : b->num_records;
+		end = b->next;
+		pthread_mutex_unlock(&b->lock);
+		if (i == end) {
+			free(scratch);
+			return NULL;
+		}
+
+		for (; i < end; i++) {
+			rec = &b->records[i];
+			if (b->tokens != NULL && rec->count <= 0) {
+				continue;
+			}
+			jsmn_init(&parser);
+			parser.pos = (jsmnuint_t) rec->start;
+			rec->count = jsmn_parse(&parser, b->js, rec->end,
+					b->tokens != NULL ? b->tokens + rec->first : NULL, (jsmnuint_t) rec->count);
+			if (b->tokens == NULL && rec->count < 0) {
+				/* Counting does not check the structure: get the error jsmn_parse() gives with tokens */
+				jsmn_init(&parser);
+				parser.pos = (jsmnuint_t) rec->start;
+				rec->count = jsmn_parse_ex(&parser, b->js, rec->end, &scratch, &num_scratch,
+						jsmn_ndjson_realloc, NULL, 0);
+			}
+		}
+	}
+}
+
+/**
+ * Runs `b` over every record on `n` threads, the calling one included.
+ */
+static void jsmn_ndjson_pass(struct jsmn_ndjson *b, unsigned int n) {
+	pthread_t threads[64];
+	int started[64];
+	unsigned int k;
+
+	b->next = 0;
+	for (k = 1; k < n; k++) {
+		started[k] = pthread_create(&threads[k], NULL, jsmn_ndjson_run, b) == 0;
+	}
+	jsmn_ndjson_run(b);
+	for (k = 1; k < n; k++) {
+		if (started[k]) {
+			pthread_join(threads[k], NULL);
 		}
 	}
+}
+
+/**
+ * Parse a buffer of newline-delimited JSON records on several threads.
+ */
+jsmnint_t jsmn_parse_ndjson(const char *js, size_t len, jsmntok_t *tokens, jsmnuint_t num_tokens,
+		jsmn_record *records, jsmnuint_t num_records, unsigned int nthreads) {
+	struct jsmn_ndjson b;
+	jsmnuint_t count = 0;
+	jsmnuint_t used = 0;
+	jsmnuint_t i;
+	size_t line = 1;
+	size_t pos;
+	size_t eol;
+
+	for (pos = 0; pos < len; pos = eol + 1, line++) {
+		eol = jsmn_ndjson_eol(js, pos, len);
+		if (jsmn_ndjson_blank(js, pos, eol)) {
+			continue;
+		}
+		if (records != NULL) {
+			if (count >= num_records) {
+				return JSMN_ERROR_NOMEM;
+			}
+			records[count].start = pos;
+			records[count].end = eol;
+			records[count].line = line;
+			records[count].first = 0;
+			records[count].count = 0;
+		}
+		count++;
+	}
+	if (records == NULL) {
+		return (jsmnint_t) count;
+	}
+
+	if (nthreads == 0) {
+		long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+		nthreads = cpus > 0 ? (unsigned int) cpus : 1;
+	}
+	if (nthreads > 64) {
+		nthreads = 64;
+	}
+	if (nthreads > (count + JSMN_NDJSON_BATCH - 1) / JSMN_NDJSON_BATCH) {
+		nthreads = (unsigned int) ((count + JSMN_NDJSON_BATCH - 1) / JSMN_NDJSON_BATCH);
+	}
+
+	b.js = js;
+	b.records = records;
+	b.num_records = count;
+	if (pthread_mutex_init(&b.lock, NULL) != 0) {
+		return JSMN_ERROR_NOMEM;
+	}
+
+	/* Count the tokens of every record, and lay them out in the arena */
+	b.tokens = NULL;
+	jsmn_ndjson_pass(&b, nthreads);
+	for (i = 0; i < count; i++) {
+		records[i].first = (jsmnint_t) used;
+		if (records[i].count < 0) {
+			continue;
+		}
+		if (tokens != NULL && records[i].count > (jsmnint_t) (num_tokens - used)) {
+			records[i].count = JSMN_ERROR_NOMEM;
+			continue;
+		}
+		used += (jsmnuint_t) records[i].count;
+	}
+
+	if (tokens != NULL) {
+		b.tokens = tokens;
+		jsmn_ndjson_pass(&b, nthreads);
+	}
+
+	pthread_mutex_destroy(&b.lock);
+	return (jsmnint_t) count;
+}
+#endif
+
+#ifdef JSMN_DOM
+jsmnint_t jsmn_dom_rollback(jsmn_parser *parser, jsmntok_t *tokens, jsmnuint_t num_tokens, jsmnint_t i) {
+	if (i == -1 || i >= (jsmnint_t) num_tokens) {
+		return JSMN_ERROR_INVAL;
+	}
+
+	parser->pos = tokens[i].start;
+	parser->toknext = i;
+
+	return i;
+}
+jsmnint_t jsmn_dom_get_value(jsmn_parser *parser, const char *js, size_t len, jsmntok_t *tokens, jsmnuint_t num_tokens, jsmnint_t i, char *buf, size_t buflen) {
+	size_t size;
+	size_t min_size;
+
+	if (i == -1 || i >= (jsmnint_t) num_tokens || tokens[i].end < tokens[i].start || buflen < 1) {
+		return JSMN_ERROR_INVAL;
+	}
+
+	size = tokens[i].end - tokens[i].start;
+	min_size = size < buflen - 1 ? size : buflen - 1;
+
+	our_memcpy(buf, &js[tokens[i].start], min_size);
+	buf[min_size] = '\0';
+
+	return size;
+}
+jsmnint_t jsmn_dom_get_start(jsmn_parser *parser, jsmntok_t *tokens, jsmnuint_t num_tokens, jsmnint_t i) {
+	if (i == -1 || i >= (jsmnint_t) num_tokens) {
+		return 0;
+	}
+
+	if (tokens[i].start >= 0) {
+		return tokens[i].start;
+	} else {
+		return 0;
+	}
+}
+size_t jsmn_dom_get_strlen(jsmn_parser *parser, jsmntok_t *tokens, jsmnuint_t num_tokens, jsmnint_t i) {
+	if (i == -1 || i >= (jsmnint_t) num_tokens) {
+		return 0;
+	}
+
+	if (tokens[i].end >= tokens[i].start) {
+		return tokens[i].end - tokens[i].start;
+	} else {
+		return 0;
+	}
+}
+size_t jsmn_dom_get_count(jsmn_parser *parser, jsmntok_t *tokens, jsmnuint_t num_tokens, jsmnint_t i) {
+	size_t count;
+	jsmnint_t dom_i;
+
+	if (i == -1 || i >= (jsmnint_t) num_tokens) {
+		return 0;
+	}
+
+	count = 0;
+
+	dom_i = jsmn_dom_get_child(parser, tokens, num_tokens, i);
+	while (dom_i != -1) {
+		count++;
+		dom_i = jsmn_dom_get_sibling(parser, tokens, num_tokens, dom_i);
+	}
+
+	return count;
+}
+jsmntype_t jsmn_dom_get_type(jsmn_parser *parser, jsmntok_t *tokens, jsmnuint_t num_tokens, jsmnint_t i) {
+	if (i == -1 || i >= (jsmnint_t) num_tokens) {
+		return JSMN_UNDEFINED;
+	}
+
+	return tokens[i].type;
+}
+jsmnint_t jsmn_dom_get_parent(jsmn_parser *parser, jsmntok_t *tokens, jsmnuint_t num_tokens, jsmnint_t i) {
+	if (i == -1 || i >= (jsmnint_t) num_tokens) {
+		return -1;
+	}
+
+	return tokens[i].family.parent;
+}
+jsmnint_t jsmn_dom_get_child(jsmn_parser *parser, jsmntok_t *tokens, jsmnuint_t num_tokens, jsmnint_t i) {
+	if (i == -1 || i >= (jsmnint_t) num_tokens) {
+		return -1;
+	}
+
+	return tokens[i].family.children.first;
+}
+jsmnint_t jsmn_dom_get_sibling(jsmn_parser *parser, jsmntok_t *tokens, jsmnuint_t num_tokens, jsmnint_t i) {
+	if (i == -1 || i >= (jsmnint_t) num_tokens) {
+		return -1;
+	}
+
+	return tokens[i].family.siblings.next;
+}
+int jsmn_dom_is_open(jsmn_parser *parser, jsmntok_t *tokens, jsmnuint_t num_tokens, jsmnint_t i) {
+	if (i == -1 || i >= (jsmnint_t) num_tokens) {
+		return 0;
+	}
+
+	return tokens[i].start != -1 && tokens[i].end == -1;
+}
+jsmnint_t jsmn_dom_get_open(jsmn_parser *parser, jsmntok_t *tokens, jsmnuint_t num_tokens, jsmnint_t i) {
+	if (i == -1 || i >= (jsmnint_t) num_tokens) {
+		return 0;
+	}
+
+	while (i != -1 && ! jsmn_dom_is_open(parser, tokens, num_tokens, i)) {
+		i = jsmn_dom_get_parent(parser, tokens, num_tokens, i);
+	}
 
 	return i;
 }
-int jsmn_dom_delete(jsmn_parser *parser, jsmntok_t *tokens, unsigned int num_tokens, int i) {
-	if (i == -1 || i >= (int) num_tokens) {
+jsmnint_t jsmn_dom_add(jsmn_parser *parser, jsmntok_t *tokens, jsmnuint_t num_tokens, jsmnint_t parent_i, jsmnint_t i) {
+	jsmnint_t rc;
+
+	rc = jsmn_dom_link(tokens, num_tokens, parent_i, i);
+	if (rc < 0) {
+		return rc;
+	}
+	jsmn_dom_touch(tokens, num_tokens, parent_i);
+
+	return rc;
+}
+int jsmn_dom_delete(jsmn_parser *parser, jsmntok_t *tokens, jsmnuint_t num_tokens, jsmnint_t i) {
+	if (i == -1 || i >= (jsmnint_t) num_tokens) {
 		return JSMN_ERROR_INVAL;
 	}
 
 	if(tokens[i].family.parent == -1) {
 		return 0;
 	}
+	jsmn_dom_touch(tokens, num_tokens, tokens[i].family.parent);
 
-	if (    tokens[tokens[i].family.siblings.prev].family.siblings.next  == i) {
+	if (tokens[i].family.siblings.prev != -1 &&
+	        tokens[tokens[i].family.siblings.prev].family.siblings.next  == i) {
 		tokens[tokens[i].family.siblings.prev].family.siblings.next  = tokens[i].family.siblings.next;
 	}
-	if (    tokens[tokens[i].family.siblings.next].family.siblings.prev  == i) {
+	if (tokens[i].family.siblings.next != -1 &&
+	        tokens[tokens[i].family.siblings.next].family.siblings.prev  == i) {
 		tokens[tokens[i].family.siblings.next].family.siblings.prev  = tokens[i].family.siblings.prev;
 	}
 	if (    tokens[tokens[i].family.parent       ].family.children.first == i) {
@@ -622,8 +2585,8 @@ int jsmn_dom_delete(jsmn_parser *parser, jsmntok_t *tokens, unsigned int num_tok
 
 	return 0;
 }
-int jsmn_dom_move(jsmn_parser *parser, jsmntok_t *tokens, unsigned int num_tokens, int parent_i, int i) {
-	int rc;
+int jsmn_dom_move(jsmn_parser *parser, jsmntok_t *tokens, jsmnuint_t num_tokens, jsmnint_t parent_i, jsmnint_t i) {
+	jsmnint_t rc;
 
 	rc = jsmn_dom_delete(parser, tokens, num_tokens, i);
 	if (rc < 0) {
@@ -637,9 +2600,9 @@ int jsmn_dom_move(jsmn_parser *parser, jsmntok_t *tokens, unsigned int num_token
 
 	return 0;
 }
-int jsmn_dom_replace(jsmn_parser *parser, jsmntok_t *tokens, unsigned int num_tokens, int prior_i, int i) {
-	int rc;
-	int parent_i;
+int jsmn_dom_replace(jsmn_parser *parser, jsmntok_t *tokens, jsmnuint_t num_tokens, jsmnint_t prior_i, jsmnint_t i) {
+	jsmnint_t rc;
+	jsmnint_t parent_i;
 
 	rc = jsmn_dom_get_parent(parser, tokens, num_tokens, prior_i);
 	if (rc < 0) {
@@ -660,24 +2623,67 @@ int jsmn_dom_replace(jsmn_parser *parser, jsmntok_t *tokens, unsigned int num_to
 
 	return 0;
 }
-int jsmn_dom_set(jsmn_parser *parser, jsmntok_t *tokens, unsigned int num_tokens, int i, jsmntype_t type, int start, int end) {
-	if (i == -1 || i >= (int) num_tokens) {
+/*
+ * Returns the cache entry of token `i`, or NULL when there is none.
+ */
+static jsmn_dom_cache *jsmn_dom_cached(jsmn_parser *parser, jsmnint_t i) {
+	if (parser->cache == NULL || i < 0 || i >= (jsmnint_t) parser->num_cache) {
+		return NULL;
+	}
+	return &parser->cache[i];
+}
+int jsmn_dom_set(jsmn_parser *parser, jsmntok_t *tokens, jsmnuint_t num_tokens, jsmnint_t i, jsmntype_t type, jsmnint_t start, jsmnint_t end) {
+	jsmn_dom_cache *entry;
+
+	if (i == -1 || i >= (jsmnint_t) num_tokens) {
 		return JSMN_ERROR_INVAL;
 	}
 
 	jsmn_fill_token(&tokens[i], type, start, end);
+	/* the parser opens objects and arrays with no end; anything else is a change */
+	if (end != -1) {
+		jsmn_dom_touch(tokens, num_tokens, i);
+	}
+
+	entry = jsmn_dom_cached(parser, i);
+	if (entry != NULL) {
+		entry->known = 0;
+	}
 
 	return 0;
 }
-int jsmn_dom_set_from(jsmn_parser *parser, jsmntok_t *tokens, unsigned int num_tokens, int to_i, int i) {
-	if (i == -1 || i >= (int) num_tokens) {
+int jsmn_dom_set_from(jsmn_parser *parser, jsmntok_t *tokens, jsmnuint_t num_tokens, jsmnint_t to_i, jsmnint_t i) {
+	jsmn_dom_cache *entry;
+
+	if (i == -1 || i >= (jsmnint_t) num_tokens) {
 		return JSMN_ERROR_INVAL;
 	}
 
-	return jsmn_dom_set(parser, tokens, num_tokens, to_i, tokens[i].type, tokens[i].start, tokens[i].end);
+	if (jsmn_dom_set(parser, tokens, num_tokens, to_i, tokens[i].type, tokens[i].start, tokens[i].end) < 0) {
+		return JSMN_ERROR_INVAL;
+	}
+	tokens[to_i].flags = tokens[i].flags & ~JSMN_DOM_DIRTY;
+	jsmn_dom_touch(tokens, num_tokens, to_i);
+
+	/* the same bytes decode the same */
+	entry = jsmn_dom_cached(parser, to_i);
+	if (entry != NULL && jsmn_dom_cached(parser, i) != NULL) {
+		*entry = *jsmn_dom_cached(parser, i);
+	}
+
+	return 0;
+}
+void jsmn_dom_cache_tokens(jsmn_parser *parser, jsmn_dom_cache *cache, jsmnuint_t num_cache) {
+	jsmnuint_t i;
+
+	parser->cache     = cache;
+	parser->num_cache = cache != NULL ? num_cache : 0;
+	for (i = 0; i < parser->num_cache; i++) {
+		cache[i].known = 0;
+	}
 }
-int jsmn_dom_close(jsmn_parser *parser, jsmntok_t *tokens, unsigned int num_tokens, int i, int end) {
-	if (i == -1 || i >= (int) num_tokens) {
+int jsmn_dom_close(jsmn_parser *parser, jsmntok_t *tokens, jsmnuint_t num_tokens, jsmnint_t i, jsmnint_t end) {
+	if (i == -1 || i >= (jsmnint_t) num_tokens) {
 		return JSMN_ERROR_INVAL;
 	}
 
@@ -689,8 +2695,8 @@ int jsmn_dom_close(jsmn_parser *parser, jsmntok_t *tokens, unsigned int num_toke
 
 	return 0;
 }
-int jsmn_dom_new(jsmn_parser *parser, jsmntok_t *tokens, unsigned int num_tokens) {
-	int i;
+jsmnint_t jsmn_dom_new(jsmn_parser *parser, jsmntok_t *tokens, jsmnuint_t num_tokens) {
+	jsmnint_t i;
 	jsmntok_t *tok;
 
 	i = parser->toknext;
@@ -702,9 +2708,9 @@ int jsmn_dom_new(jsmn_parser *parser, jsmntok_t *tokens, unsigned int num_tokens
 
 	return i;	
 }
-int jsmn_dom_new_as(jsmn_parser *parser, jsmntok_t *tokens, unsigned int num_tokens, jsmntype_t type, int start, int end) {
-	int rc;
-	int i;
+jsmnint_t jsmn_dom_new_as(jsmn_parser *parser, jsmntok_t *tokens, jsmnuint_t num_tokens, jsmntype_t type, jsmnint_t start, jsmnint_t end) {
+	jsmnint_t rc;
+	jsmnint_t i;
 
 	i = jsmn_dom_new(parser, tokens, num_tokens);
 	if (i < 0) {
@@ -718,15 +2724,15 @@ int jsmn_dom_new_as(jsmn_parser *parser, jsmntok_t *tokens, unsigned int num_tok
 
 	return i;
 }
-int jsmn_dom_new_object(jsmn_parser *parser, jsmntok_t *tokens, unsigned int num_tokens) {
+jsmnint_t jsmn_dom_new_object(jsmn_parser *parser, jsmntok_t *tokens, jsmnuint_t num_tokens) {
 	return jsmn_dom_new_as(parser, tokens, num_tokens, JSMN_OBJECT, 0, 0);
 }
-int jsmn_dom_new_array(jsmn_parser *parser, jsmntok_t *tokens, unsigned int num_tokens) {
+jsmnint_t jsmn_dom_new_array(jsmn_parser *parser, jsmntok_t *tokens, jsmnuint_t num_tokens) {
 	return jsmn_dom_new_as(parser, tokens, num_tokens, JSMN_ARRAY, 0, 0);
-}
-int jsmn_dom_new_primitive(jsmn_parser *parser, char *js, size_t len, jsmntok_t *tokens, unsigned int num_tokens, const char *value) {
-	int i;
-	int rc;
+}
+jsmnint_t jsmn_dom_new_primitive(jsmn_parser *parser, char *js, size_t len, jsmntok_t *tokens, jsmnuint_t num_tokens, const char *value) {
+	jsmnint_t i;
+	jsmnint_t rc;
 	size_t size;
 
 	size = strlen(value);
@@ -750,62 +2756,82 @@ int jsmn_dom_new_primitive(jsmn_parser *parser, char *js, size_t len, jsmntok_t
 
 	return i;
 }
-int jsmn_dom_dup_primitive(jsmn_parser *parser, jsmntok_t *tokens, unsigned int num_tokens, int i) {
-	if (i == -1 || i >= (int) num_tokens) {
+jsmnint_t jsmn_dom_dup_primitive(jsmn_parser *parser, jsmntok_t *tokens, jsmnuint_t num_tokens, jsmnint_t i) {
+	if (i == -1 || i >= (jsmnint_t) num_tokens) {
 		return JSMN_ERROR_INVAL;
 	}
 
 	return jsmn_dom_new_as(parser, tokens, num_tokens, tokens[i].type, tokens[i].start, tokens[i].end);
 }
-int jsmn_dom_is_null(jsmn_parser *parser, const char *js, size_t len, jsmntok_t *tokens, unsigned int num_tokens, int i) {
-	if (i == -1 || i >= (int) num_tokens) {
+int jsmn_dom_is_null(jsmn_parser *parser, const char *js, size_t len, jsmntok_t *tokens, jsmnuint_t num_tokens, jsmnint_t i) {
+	if (i == -1 || i >= (jsmnint_t) num_tokens) {
 		return 0;
 	}
 
+	/* classified by the parser */
+	if (tokens[i].type == JSMN_PRIMITIVE && tokens[i].flags != 0) {
+		return tokens[i].flags == JSMN_PRIMITIVE_NULL;
+	}
+
 	if (tokens[i].type == JSMN_PRIMITIVE && tokens[i].start != -1 && tokens[i].start < tokens[i].end && js[tokens[i].start] == 'n') {
 		return 1;
 	} else {
 		return 0;
 	}
 }
-int jsmn_dom_is_bool(jsmn_parser *parser, const char *js, size_t len, jsmntok_t *tokens, unsigned int num_tokens, int i) {
-	if (i == -1 || i >= (int) num_tokens) {
+int jsmn_dom_is_bool(jsmn_parser *parser, const char *js, size_t len, jsmntok_t *tokens, jsmnuint_t num_tokens, jsmnint_t i) {
+	if (i == -1 || i >= (jsmnint_t) num_tokens) {
 		return 0;
 	}
 
+	/* classified by the parser */
+	if (tokens[i].type == JSMN_PRIMITIVE && tokens[i].flags != 0) {
+		return tokens[i].flags == JSMN_PRIMITIVE_TRUE || tokens[i].flags == JSMN_PRIMITIVE_FALSE;
+	}
+
 	if (tokens[i].type == JSMN_PRIMITIVE && tokens[i].start != -1 && tokens[i].start < tokens[i].end && (js[tokens[i].start] == 't' || js[tokens[i].start] == 'f')) {
 		return 1;
 	} else {
 		return 0;
 	}
 }
-int jsmn_dom_is_true(jsmn_parser *parser, const char *js, size_t len, jsmntok_t *tokens, unsigned int num_tokens, int i) {
-	if (i == -1 || i >= (int) num_tokens) {
+int jsmn_dom_is_true(jsmn_parser *parser, const char *js, size_t len, jsmntok_t *tokens, jsmnuint_t num_tokens, jsmnint_t i) {
+	if (i == -1 || i >= (jsmnint_t) num_tokens) {
 		return 0;
 	}
 
+	/* classified by the parser */
+	if (tokens[i].type == JSMN_PRIMITIVE && tokens[i].flags != 0) {
+		return tokens[i].flags == JSMN_PRIMITIVE_TRUE;
+	}
+
 	if (tokens[i].type == JSMN_PRIMITIVE && tokens[i].start != -1 && tokens[i].start < tokens[i].end && js[tokens[i].start] == 't') {
 		return 1;
 	} else {
 		return 0;
 	}
 }
-int jsmn_dom_is_false(jsmn_parser *parser, const char *js, size_t len, jsmntok_t *tokens, unsigned int num_tokens, int i) {
-	if (i == -1 || i >= (int) num_tokens) {
+int jsmn_dom_is_false(jsmn_parser *parser, const char *js, size_t len, jsmntok_t *tokens, jsmnuint_t num_tokens, jsmnint_t i) {
+	if (i == -1 || i >= (jsmnint_t) num_tokens) {
 		return 0;
 	}
 
+	/* classified by the parser */
+	if (tokens[i].type == JSMN_PRIMITIVE && tokens[i].flags != 0) {
+		return tokens[i].flags == JSMN_PRIMITIVE_FALSE;
+	}
+
 	if (tokens[i].type == JSMN_PRIMITIVE && tokens[i].start != -1 && tokens[i].start < tokens[i].end && js[tokens[i].start] == 'f') {
 		return 1;
 	} else {
 		return 0;
 	}
 }
-int jsmn_dom_get_integer(jsmn_parser *parser, const char *js, size_t len, jsmntok_t *tokens, unsigned int num_tokens, int i, int *value_ptr) {
+int jsmn_dom_get_integer(jsmn_parser *parser, const char *js, size_t len, jsmntok_t *tokens, jsmnuint_t num_tokens, jsmnint_t i, int *value_ptr) {
 #ifdef USE_LIBC
 	int rc;
 
-	if (i == -1 || i >= (int) num_tokens || tokens[i].end < tokens[i].start || value_ptr == NULL) {
+	if (i == -1 || i >= (jsmnint_t) num_tokens || tokens[i].end < tokens[i].start || value_ptr == NULL) {
 		return JSMN_ERROR_INVAL;
 	}
 
@@ -821,7 +2847,7 @@ int jsmn_dom_get_integer(jsmn_parser *parser, const char *js, size_t len, jsmnto
 	const char *val_cursor;
 	const char *val_stop;
 
-	if (i == -1 || i >= (int) num_tokens || tokens[i].end < tokens[i].start || value_ptr == NULL) {
+	if (i == -1 || i >= (jsmnint_t) num_tokens || tokens[i].end < tokens[i].start || value_ptr == NULL) {
 		return JSMN_ERROR_INVAL;
 	}
 	
@@ -846,238 +2872,1000 @@ int jsmn_dom_get_integer(jsmn_parser *parser, const char *js, size_t len, jsmnto
 		}
 	}
 
-	value = negative ? - value : value;
-
-	*value_ptr = value;
-#endif
+	value = negative ? - value : value;
+
+	*value_ptr = value;
+#endif
+
+	return 0;
+}
+jsmnint_t jsmn_dom_new_integer(jsmn_parser *parser, char *js, size_t len, jsmntok_t *tokens, jsmnuint_t num_tokens, int value) {
+	return jsmn_dom_new_int64(parser, js, len, tokens, num_tokens, value);
+}
+/*
+ * 64-bit integers.
+ * Digits are read eight at a time: one 64-bit load is checked for being all digits and
+ * folded into its value with three multiplies. They are written two at a time from a table.
+ */
+static const char jsmn_digit_pairs[] =
+	"00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+	"40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+	"8081828384858687888990919293949596979899";
+/*
+ * Reads the unsigned decimal in [`cursor`, `stop`): JSMN_ERROR_INVAL unless it is all
+ * digits, JSMN_ERROR_RANGE past 2^64 - 1.
+ */
+static int jsmn_parse_u64(const char *cursor, const char *stop, unsigned long long *value_ptr) {
+	unsigned long long value;
+	unsigned long long chunk;
+	int n;
+	int k;
+
+	if (cursor >= stop) {
+		return JSMN_ERROR_INVAL;
+	}
+	while (cursor + 1 < stop && *cursor == '0') {
+		cursor++;
+	}
+
+	value = 0;
+	for (n = 0; stop - cursor >= 8 && n + 8 <= 19; n += 8, cursor += 8) {
+		chunk = 0;
+		for (k = 7; k >= 0; k--) {
+			chunk = chunk << 8 | (unsigned char) cursor[k];
+		}
+		/* every byte in '0'..'9': high nibble 3, and adding 6 does not carry into it */
+		if (((chunk & 0xF0F0F0F0F0F0F0F0ULL) | (((chunk + 0x0606060606060606ULL) & 0xF0F0F0F0F0F0F0F0ULL) >> 4)) != 0x3333333333333333ULL) {
+			break;
+		}
+		chunk -= 0x3030303030303030ULL;
+		chunk = chunk * 10 + (chunk >> 8);
+		chunk = ((chunk & 0x000000FF000000FFULL) * (100 + (1000000ULL << 32))
+		      + ((chunk >> 16) & 0x000000FF000000FFULL) * (1 + (10000ULL << 32))) >> 32;
+		value = value * 100000000 + chunk;
+	}
+	for (; cursor < stop && n < 19; n++, cursor++) {
+		if (*cursor < '0' || *cursor > '9') {
+			return JSMN_ERROR_INVAL;
+		}
+		value = value * 10 + (unsigned long long) (*cursor - '0');
+	}
+	if (cursor < stop) {
+		/* a twentieth digit may still fit, a twenty-first never does */
+		for (k = 0; cursor + k < stop; k++) {
+			if (cursor[k] < '0' || cursor[k] > '9') {
+				return JSMN_ERROR_INVAL;
+			}
+		}
+		if (k > 1 || value > (~0ULL - (unsigned long long) (*cursor - '0')) / 10) {
+			return JSMN_ERROR_RANGE;
+		}
+		value = value * 10 + (unsigned long long) (*cursor - '0');
+	}
+
+	*value_ptr = value;
+
+	return 0;
+}
+/*
+ * Writes `value`, after a '-' when `negative`, into `buf` (at least 21 bytes, not
+ * terminated). Returns the length.
+ */
+static int jsmn_format_u64(unsigned long long value, int negative, char *buf) {
+	char digits[20];
+	int pos;
+	int len;
+	int k;
+
+	pos = 20;
+	while (value >= 100) {
+		k = (int) (value % 100) * 2;
+		value /= 100;
+		digits[--pos] = jsmn_digit_pairs[k + 1];
+		digits[--pos] = jsmn_digit_pairs[k];
+	}
+	if (value >= 10) {
+		k = (int) value * 2;
+		digits[--pos] = jsmn_digit_pairs[k + 1];
+		digits[--pos] = jsmn_digit_pairs[k];
+	} else {
+		digits[--pos] = (char) ('0' + value);
+	}
+
+	len = 0;
+	if (negative) {
+		buf[len++] = '-';
+	}
+	for (; pos < 20; pos++) {
+		buf[len++] = digits[pos];
+	}
+
+	return len;
+}
+/*
+ * Reads the signed decimal in [`cursor`, `stop`) like jsmn_parse_u64().
+ */
+static int jsmn_parse_i64(const char *cursor, const char *stop, long long *value_ptr) {
+	unsigned long long value;
+	int negative;
+	int rc;
+
+	negative = cursor < stop && *cursor == '-';
+	rc = jsmn_parse_u64(cursor + negative, stop, &value);
+	if (rc < 0) {
+		return rc;
+	}
+	if (value > (negative ? 0x8000000000000000ULL : 0x7FFFFFFFFFFFFFFFULL)) {
+		return JSMN_ERROR_RANGE;
+	}
+
+	*value_ptr = negative ? (long long) (0 - value) : (long long) value;
+
+	return 0;
+}
+int jsmn_dom_get_int64(jsmn_parser *parser, const char *js, size_t len, jsmntok_t *tokens, jsmnuint_t num_tokens, jsmnint_t i, long long *value_ptr) {
+	jsmn_dom_cache *entry;
+	int rc;
+
+	(void) len;
+	if (i == -1 || i >= (jsmnint_t) num_tokens || tokens[i].end < tokens[i].start || value_ptr == NULL) {
+		return JSMN_ERROR_INVAL;
+	}
+	if (tokens[i].type == JSMN_PRIMITIVE && tokens[i].flags != 0 && tokens[i].flags < JSMN_PRIMITIVE_INTEGER) {
+		return JSMN_ERROR_INVAL; /* null, true or false */
+	}
+
+	entry = jsmn_dom_cached(parser, i);
+	if (entry != NULL && (entry->known & JSMN_DOM_CACHE_INT64)) {
+		*value_ptr = entry->int64;
+		return 0;
+	}
+
+	rc = jsmn_parse_i64(js + tokens[i].start, js + tokens[i].end, value_ptr);
+	if (rc == 0 && entry != NULL) {
+		entry->int64 = *value_ptr;
+		entry->known |= JSMN_DOM_CACHE_INT64;
+	}
+
+	return rc;
+}
+int jsmn_dom_get_uint64(jsmn_parser *parser, const char *js, size_t len, jsmntok_t *tokens, jsmnuint_t num_tokens, jsmnint_t i, unsigned long long *value_ptr) {
+	jsmn_dom_cache *entry;
+	unsigned long long value;
+	int negative;
+	int rc;
+
+	(void) len;
+	if (i == -1 || i >= (jsmnint_t) num_tokens || tokens[i].end < tokens[i].start || value_ptr == NULL) {
+		return JSMN_ERROR_INVAL;
+	}
+	if (tokens[i].type == JSMN_PRIMITIVE && tokens[i].flags != 0 && tokens[i].flags < JSMN_PRIMITIVE_INTEGER) {
+		return JSMN_ERROR_INVAL; /* null, true or false */
+	}
+
+	entry = jsmn_dom_cached(parser, i);
+	if (entry != NULL && (entry->known & JSMN_DOM_CACHE_UINT64)) {
+		*value_ptr = entry->uint64;
+		return 0;
+	}
+
+	negative = tokens[i].start < tokens[i].end && js[tokens[i].start] == '-';
+	rc = jsmn_parse_u64(js + tokens[i].start + negative, js + tokens[i].end, &value);
+	if (rc < 0) {
+		return rc;
+	}
+	if (negative && value != 0) {
+		return JSMN_ERROR_RANGE;
+	}
+
+	*value_ptr = value;
+	if (entry != NULL) {
+		entry->uint64 = value;
+		entry->known |= JSMN_DOM_CACHE_UINT64;
+	}
+
+	return 0;
+}
+jsmnint_t jsmn_dom_new_int64(jsmn_parser *parser, char *js, size_t len, jsmntok_t *tokens, jsmnuint_t num_tokens, long long value) {
+	char valbuf[32];
+	int pos;
+
+	pos = value < 0 ? jsmn_format_u64(0 - (unsigned long long) value, 1, valbuf) : jsmn_format_u64((unsigned long long) value, 0, valbuf);
+	valbuf[pos++] = ' ';
+	valbuf[pos++] = '\0';
+
+	return jsmn_dom_new_primitive(parser, js, len, tokens, num_tokens, valbuf);
+}
+jsmnint_t jsmn_dom_new_uint64(jsmn_parser *parser, char *js, size_t len, jsmntok_t *tokens, jsmnuint_t num_tokens, unsigned long long value) {
+	char valbuf[32];
+	int pos;
+
+	pos = jsmn_format_u64(value, 0, valbuf);
+	valbuf[pos++] = ' ';
+	valbuf[pos++] = '\0';
+
+	return jsmn_dom_new_primitive(parser, js, len, tokens, num_tokens, valbuf);
+}
+/*
+ * Decimal to binary64 conversion.
+ * Numbers with at most 19 significant digits are converted either exactly (Clinger: the
+ * mantissa and the power of ten are both exact doubles) or with the Eisel-Lemire algorithm,
+ * which multiplies by a 128-bit power of ten and bails out when the product is too close to
+ * a rounding boundary to decide. Those rare inputs, subnormals, overflows and longer inputs
+ * that cannot be bracketed go through a slow but exact multiple-precision decimal.
+ */
+#define JSMN_DOUBLE_DIGITS 19
+#define JSMN_DECIMAL_DIGITS 800
+#define JSMN_DECIMAL_SHIFT 60
+typedef union {
+	double value;
+	unsigned long long bits;
+} jsmn_double_bits;
+typedef struct {
+	unsigned char d[JSMN_DECIMAL_DIGITS]; /* digit values, most significant first */
+	int nd;                               /* number of digits used */
+	int dp;                               /* decimal point: value is 0.d[0..nd) * 10^dp */
+	int trunc;                            /* nonzero digits were dropped past d[] */
+} jsmn_decimal;
+static const double jsmn_exact_pow10[] = {
+	1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+static int jsmn_clz64(unsigned long long x) {
+#ifdef __GNUC__
+	return __builtin_clzll(x);
+#else
+	int n;
+
+	for (n = 0; !(x & 0x8000000000000000ULL); n++) {
+		x <<= 1;
+	}
+
+	return n;
+#endif
+}
+/*
+ * Full 64x64 -> 128-bit product.
+ */
+static void jsmn_mul64(unsigned long long a, unsigned long long b, unsigned long long *hi, unsigned long long *lo) {
+#ifdef __SIZEOF_INT128__
+	unsigned __int128 p;
+
+	p   = (unsigned __int128) a * b;
+	*hi = (unsigned long long) (p >> 64);
+	*lo = (unsigned long long) p;
+#else
+	unsigned long long ll, lh, hl, hh, mid;
+
+	ll  = (a & 0xFFFFFFFFULL) * (b & 0xFFFFFFFFULL);
+	lh  = (a & 0xFFFFFFFFULL) * (b >> 32);
+	hl  = (a >> 32) * (b & 0xFFFFFFFFULL);
+	hh  = (a >> 32) * (b >> 32);
+	mid = (ll >> 32) + (lh & 0xFFFFFFFFULL) + (hl & 0xFFFFFFFFULL);
+	*lo = (mid << 32) | (ll & 0xFFFFFFFFULL);
+	*hi = hh + (lh >> 32) + (hl >> 32) + (mid >> 32);
+#endif
+}
+/*
+ * Computes `mantissa` * 10^`exp10` correctly rounded into `*value`, for a nonzero
+ * `mantissa`. Returns 0 when the result cannot be decided this way (it is too close to a
+ * halfway point, subnormal or out of range) and the caller must fall back.
+ */
+static int jsmn_eisel_lemire(unsigned long long mantissa, int exp10, double *value) {
+	jsmn_double_bits u;
+	unsigned long long x_hi, x_lo, y_hi, y_lo, merged_hi, merged_lo;
+	long exp2;
+	int clz;
+	int msb;
+
+	if (exp10 < POW10_MIN_EXP10 || exp10 > POW10_MAX_EXP10) {
+		return 0;
+	}
+
+	/* normalize, and estimate the binary exponent as floor(exp10 * log2(10)) */
+	clz = jsmn_clz64(mantissa);
+	mantissa <<= clz;
+	exp2 = exp10 >= 0 ? (217706L * exp10) >> 16 : -((217706L * -exp10 + 65535) >> 16);
+	exp2 += 64 + 1023 - clz;
+
+	jsmn_mul64(mantissa, pow10_128[exp10 - POW10_MIN_EXP10][0], &x_hi, &x_lo);
+
+	/* the truncated high half is not enough when all the bits below the mantissa are set */
+	if ((x_hi & 0x1FF) == 0x1FF && x_lo + mantissa < mantissa) {
+		jsmn_mul64(mantissa, pow10_128[exp10 - POW10_MIN_EXP10][1], &y_hi, &y_lo);
+		merged_hi = x_hi;
+		merged_lo = x_lo + y_hi;
+		if (merged_lo < x_lo) {
+			merged_hi++;
+		}
+		if ((merged_hi & 0x1FF) == 0x1FF && merged_lo + 1 == 0 && y_lo + mantissa < mantissa) {
+			return 0;
+		}
+		x_hi = merged_hi;
+		x_lo = merged_lo;
+	}
+
+	/* keep 54 bits, then round to even into 53 */
+	msb = (int) (x_hi >> 63);
+	mantissa = x_hi >> (msb + 9);
+	exp2 -= 1 ^ msb;
+
+	if (x_lo == 0 && (x_hi & 0x1FF) == 0 && (mantissa & 3) == 1) {
+		return 0; /* exactly halfway, as far as these bits can tell */
+	}
+
+	mantissa += mantissa & 1;
+	mantissa >>= 1;
+	if (mantissa >> 53 > 0) {
+		mantissa >>= 1;
+		exp2++;
+	}
+
+	if (exp2 <= 0 || exp2 >= 0x7FF) {
+		return 0;
+	}
+
+	u.bits = ((unsigned long long) exp2 << 52) | (mantissa & 0x000FFFFFFFFFFFFFULL);
+	*value = u.value;
+
+	return 1;
+}
+static void jsmn_decimal_trim(jsmn_decimal *a) {
+	while (a->nd > 0 && a->d[a->nd - 1] == 0) {
+		a->nd--;
+	}
+	if (a->nd == 0) {
+		a->dp = 0;
+	}
+}
+/*
+ * Multiplies by 2^k, k <= JSMN_DECIMAL_SHIFT.
+ */
+static void jsmn_decimal_lshift(jsmn_decimal *a, unsigned int k) {
+	unsigned char tmp[JSMN_DECIMAL_DIGITS + 20];
+	unsigned long long n;
+	unsigned long long quo;
+	int r;
+	int w;
+	int nd;
+
+	n = 0;
+	w = sizeof(tmp);
+	for (r = a->nd - 1; r >= 0; r--) {
+		n += (unsigned long long) a->d[r] << k;
+		quo = n / 10;
+		tmp[--w] = (unsigned char) (n - 10 * quo);
+		n = quo;
+	}
+	while (n > 0) {
+		quo = n / 10;
+		tmp[--w] = (unsigned char) (n - 10 * quo);
+		n = quo;
+	}
+
+	nd = sizeof(tmp) - w;
+	a->dp += nd - a->nd;
+	if (nd > JSMN_DECIMAL_DIGITS) {
+		for (r = JSMN_DECIMAL_DIGITS; r < nd; r++) {
+			if (tmp[w + r] != 0) {
+				a->trunc = 1;
+			}
+		}
+		nd = JSMN_DECIMAL_DIGITS;
+	}
+	for (r = 0; r < nd; r++) {
+		a->d[r] = tmp[w + r];
+	}
+	a->nd = nd;
+	jsmn_decimal_trim(a);
+}
+/*
+ * Divides by 2^k, k <= JSMN_DECIMAL_SHIFT.
+ */
+static void jsmn_decimal_rshift(jsmn_decimal *a, unsigned int k) {
+	unsigned long long n;
+	unsigned long long mask;
+	unsigned long long dig;
+	int r;
+	int w;
+
+	n = 0;
+	for (r = 0; n >> k == 0; r++) {
+		if (r >= a->nd) {
+			if (n == 0) {
+				a->nd = 0;
+				return;
+			}
+			while (n >> k == 0) {
+				n *= 10;
+				r++;
+			}
+			break;
+		}
+		n = n * 10 + a->d[r];
+	}
+	a->dp -= r - 1;
+
+	mask = (1ULL << k) - 1;
+	for (w = 0; r < a->nd; r++) {
+		dig = n >> k;
+		n &= mask;
+		a->d[w++] = (unsigned char) dig;
+		n = n * 10 + a->d[r];
+	}
+	while (n > 0) {
+		dig = n >> k;
+		n &= mask;
+		if (w < JSMN_DECIMAL_DIGITS) {
+			a->d[w++] = (unsigned char) dig;
+		} else if (dig > 0) {
+			a->trunc = 1;
+		}
+		n *= 10;
+	}
+	a->nd = w;
+	jsmn_decimal_trim(a);
+}
+static void jsmn_decimal_shift(jsmn_decimal *a, int k) {
+	if (a->nd == 0) {
+		return;
+	}
+	for (; k > JSMN_DECIMAL_SHIFT; k -= JSMN_DECIMAL_SHIFT) {
+		jsmn_decimal_lshift(a, JSMN_DECIMAL_SHIFT);
+	}
+	for (; k < -JSMN_DECIMAL_SHIFT; k += JSMN_DECIMAL_SHIFT) {
+		jsmn_decimal_rshift(a, JSMN_DECIMAL_SHIFT);
+	}
+	if (k > 0) {
+		jsmn_decimal_lshift(a, k);
+	} else if (k < 0) {
+		jsmn_decimal_rshift(a, -k);
+	}
+}
+/*
+ * The integer part, rounded half to even (half up when digits were dropped).
+ */
+static unsigned long long jsmn_decimal_round(const jsmn_decimal *a) {
+	unsigned long long n;
+	int i;
+	int up;
+
+	n = 0;
+	for (i = 0; i < a->dp && i < a->nd; i++) {
+		n = n * 10 + a->d[i];
+	}
+	for (; i < a->dp; i++) {
+		n *= 10;
+	}
+
+	up = 0;
+	if (a->dp >= 0 && a->dp < a->nd) {
+		if (a->d[a->dp] == 5 && a->dp + 1 == a->nd) {
+			up = a->trunc || (a->dp > 0 && (a->d[a->dp - 1] & 1));
+		} else {
+			up = a->d[a->dp] >= 5;
+		}
+	}
+
+	return n + up;
+}
+/*
+ * Exact conversion: scale by powers of two into [1/2, 1), then pull out 53 bits.
+ */
+static double jsmn_decimal_to_double(jsmn_decimal *a) {
+	static const int powtab[] = { 1, 3, 6, 9, 13, 16, 19, 23, 26 };
+	jsmn_double_bits u;
+	unsigned long long mantissa;
+	int exp2;
+	int n;
+
+	if (a->nd == 0 || a->dp < -330) {
+		u.bits = 0;
+		return u.value;
+	}
+	if (a->dp > 310) {
+		u.bits = 0x7FF0000000000000ULL;
+		return u.value;
+	}
+
+	exp2 = 0;
+	while (a->dp > 0) {
+		n = a->dp >= (int) (sizeof(powtab) / sizeof(powtab[0])) ? 27 : powtab[a->dp];
+		jsmn_decimal_shift(a, -n);
+		exp2 += n;
+	}
+	while (a->dp < 0 || (a->dp == 0 && a->d[0] < 5)) {
+		n = -a->dp >= (int) (sizeof(powtab) / sizeof(powtab[0])) ? 27 : powtab[-a->dp];
+		jsmn_decimal_shift(a, n);
+		exp2 -= n;
+	}
+
+	/* [1/2, 1) to [1, 2), then denormalize below the smallest normal exponent */
+	exp2--;
+	if (exp2 < -1022) {
+		jsmn_decimal_shift(a, exp2 + 1022);
+		exp2 = -1022;
+	}
+	if (exp2 > 1023) {
+		u.bits = 0x7FF0000000000000ULL;
+		return u.value;
+	}
+
+	jsmn_decimal_shift(a, 53);
+	mantissa = jsmn_decimal_round(a);
+	if (mantissa == 2ULL << 52) {
+		mantissa >>= 1;
+		exp2++;
+		if (exp2 > 1023) {
+			u.bits = 0x7FF0000000000000ULL;
+			return u.value;
+		}
+	}
+	if (!(mantissa & (1ULL << 52))) {
+		exp2 = -1023; /* subnormal */
+	}
+
+	u.bits = ((unsigned long long) (exp2 + 1023) << 52) | (mantissa & 0x000FFFFFFFFFFFFFULL);
+	return u.value;
+}
+/*
+ * Reads the number in [`val_cursor`, `val_stop`): JSMN_ERROR_INVAL when it has no digits.
+ */
+static int jsmn_parse_double(const char *val_cursor, const char *val_stop, double *value_ptr) {
+	jsmn_decimal decimal;
+	unsigned long long mantissa;
+	double value;
+	double upper;
+	int negative;
+	int truncated;
+	int digits;
+	int any;
+	int exp10;
+	int exponent;
+	int e_negative;
+	int point;
+	const char *num_start;
+
+	mantissa   = 0;
+	negative   = 0;
+	truncated  = 0;
+	digits     = 0;
+	any        = 0;
+	exp10      = 0;
+	exponent   = 0;
+	e_negative = 0;
+	point      = 0;
+
+	if (val_cursor < val_stop && *val_cursor == '-') {
+		negative = 1;
+		val_cursor++;
+	}
+
+	/* the first 19 significant digits fit the mantissa; past those only note what is lost */
+	num_start = val_cursor;
+	for (; val_cursor < val_stop; val_cursor++) {
+		if (*val_cursor >= '0' && *val_cursor <= '9') {
+			any = 1;
+			if (digits < JSMN_DOUBLE_DIGITS) {
+				if (mantissa != 0 || *val_cursor != '0') {
+					mantissa = mantissa * 10 + (unsigned long long) (*val_cursor - '0');
+					digits++;
+				}
+				exp10 -= point;
+			} else {
+				truncated |= *val_cursor != '0';
+				exp10 += !point;
+			}
+		} else if (*val_cursor == '.' && !point) {
+			point = 1;
+		} else {
+			break;
+		}
+	}
+	if (!any) {
+		return JSMN_ERROR_INVAL;
+	}
+
+	if (val_cursor < val_stop && (*val_cursor == 'e' || *val_cursor == 'E')) {
+		val_cursor++;
+		if (val_cursor < val_stop && (*val_cursor == '-' || *val_cursor == '+')) {
+			e_negative = *val_cursor == '-';
+			val_cursor++;
+		}
+		for (; val_cursor < val_stop && *val_cursor >= '0' && *val_cursor <= '9'; val_cursor++) {
+			if (exponent < 100000) {
+				exponent = exponent * 10 + (*val_cursor - '0');
+			}
+		}
+	}
+	exp10 += e_negative ? - exponent : exponent;
+
+	if (mantissa == 0) {
+		value = 0.0;
+	} else if (!truncated && mantissa <= (1ULL << 53) && exp10 >= -22 && exp10 <= 22) {
+		value = exp10 < 0 ? (double) mantissa / jsmn_exact_pow10[-exp10] : (double) mantissa * jsmn_exact_pow10[exp10];
+	} else if (jsmn_eisel_lemire(mantissa, exp10, &value)
+	       && (!truncated || (jsmn_eisel_lemire(mantissa + 1, exp10, &upper) && upper == value))) {
+		/* a truncated mantissa is only good when rounding it up gives the same double */
+	} else {
+		decimal.nd    = 0;
+		decimal.dp    = 0;
+		decimal.trunc = 0;
+		digits        = 0;
+		point         = 0;
+		for (val_cursor = num_start; val_cursor < val_stop; val_cursor++) {
+			if (*val_cursor >= '0' && *val_cursor <= '9') {
+				if (digits == 0 && *val_cursor == '0') {
+					decimal.dp--;
+					continue;
+				}
+				if (decimal.nd < JSMN_DECIMAL_DIGITS) {
+					decimal.d[decimal.nd++] = (unsigned char) (*val_cursor - '0');
+				} else if (*val_cursor != '0') {
+					decimal.trunc = 1;
+				}
+				digits++;
+			} else if (*val_cursor == '.' && !point) {
+				point = 1;
+				decimal.dp = digits;
+			} else {
+				break;
+			}
+		}
+		if (!point) {
+			decimal.dp = digits;
+		}
+		decimal.dp += e_negative ? - exponent : exponent;
+		jsmn_decimal_trim(&decimal);
+		value = jsmn_decimal_to_double(&decimal);
+	}
+
+	*value_ptr = negative ? - value : value;
 
 	return 0;
 }
-int jsmn_dom_new_integer(jsmn_parser *parser, char *js, size_t len, jsmntok_t *tokens, unsigned int num_tokens, int value) {
-	char valbuf[32];
-#ifdef USE_LIBC
+int jsmn_dom_get_double(jsmn_parser *parser, const char *js, size_t len, jsmntok_t *tokens, jsmnuint_t num_tokens, jsmnint_t i, double *value_ptr) {
+	jsmn_dom_cache *entry;
 	int rc;
 
-	rc = snprintf(valbuf, sizeof (valbuf), "%i ", value);
-	if (rc == -1) {
+	if (i == -1 || i >= (jsmnint_t) num_tokens || tokens[i].end < tokens[i].start || value_ptr == NULL) {
 		return JSMN_ERROR_INVAL;
 	}
-
-	return jsmn_dom_new_primitive(parser, js, len, tokens, num_tokens, valbuf);
-#else
-	int  valpos;
-	int  negative;
-	
-	valbuf[31] = ' '; /* delimiter */
-	negative = value < 0;
-	if (negative) {
-		value = - value;
-	}
-	for (valpos = 30; value > 0 && valpos > 0; valpos--) {
-		valbuf[valpos] = '0' + (value % 10);
-		value /= 10;
+	if (tokens[i].type == JSMN_PRIMITIVE && tokens[i].flags != 0 && tokens[i].flags < JSMN_PRIMITIVE_INTEGER) {
+		return JSMN_ERROR_INVAL; /* null, true or false */
 	}
-	if (valpos == 30) {
-		valbuf[valpos] = '0';
-	} else if (negative) {
-		valbuf[valpos] = '-';
-	} else {
-		valpos++;
-	}
-
-	return jsmn_dom_new_primitive(parser, js, len, tokens, num_tokens, valbuf + valpos);
-#endif
-}
-int jsmn_dom_get_double(jsmn_parser *parser, const char *js, size_t len, jsmntok_t *tokens, unsigned int num_tokens, int i, double *value_ptr) {
-#ifdef USE_LIBC
-	int rc;
 
-	if (i == -1 || i >= (int) num_tokens || tokens[i].end < tokens[i].start || value_ptr == NULL) {
-		return JSMN_ERROR_INVAL;
+	entry = jsmn_dom_cached(parser, i);
+	if (entry != NULL && (entry->known & JSMN_DOM_CACHE_DOUBLE)) {
+		*value_ptr = entry->number;
+		return 0;
 	}
 
-	rc = sscanf(js + tokens[i].start, "%lf", value_ptr);
-	if (rc != 1) {
-		return JSMN_ERROR_INVAL;
+	rc = jsmn_parse_double(js + tokens[i].start, js + tokens[i].end, value_ptr);
+	if (rc == 0 && entry != NULL) {
+		entry->number = *value_ptr;
+		entry->known |= JSMN_DOM_CACHE_DOUBLE;
 	}
-#else
-	double value;
+
+	return rc;
+}
+/*
+ * Bulk conversion of the children of an array. The token checks are made once for the
+ * array, numbers are told apart by their parser class, and short integers skip the
+ * decimal conversion: they are read eight digits at a time and are exact doubles.
+ */
+jsmnint_t jsmn_dom_get_doubles(jsmn_parser *parser, const char *js, size_t len, jsmntok_t *tokens, jsmnuint_t num_tokens, jsmnint_t array_i, double *values, size_t num_values, jsmnint_t *stop_i) {
+	unsigned long long magnitude;
+	jsmnint_t i;
+	jsmnint_t start;
+	size_t n;
 	int negative;
-	int e_negative;
-	int decimal;
-	int exponent;
-	int pos;
-	const char *val_start;
-	const char *val_cursor;
-	const char *val_stop;
-	const char *num_start;
-	const char *dec_start;
 
-	if (i == -1 || i >= (int) num_tokens || tokens[i].end < tokens[i].start || value_ptr == NULL) {
+	(void) parser;
+	(void) len;
+	if (array_i == -1 || array_i >= (jsmnint_t) num_tokens || tokens[array_i].type != JSMN_ARRAY || values == NULL) {
 		return JSMN_ERROR_INVAL;
 	}
-	
-	value      = 0;
-	negative   = 0;
-	decimal    = 0;
-	exponent   = 0;
-	e_negative = 0;
-	pos        = 0;
-	val_start  = js + tokens[i].start;
-	val_cursor = val_start;
-	val_stop   = js + tokens[i].end;
-	num_start  = val_cursor;
-	dec_start  = NULL;
-
-	if (val_cursor + 1 < val_stop) {
-		if (*val_cursor =='-') {
-			negative = 1;
-			val_cursor++;
-		}
+	if (stop_i != NULL) {
+		*stop_i = -1;
 	}
 
-	num_start = val_cursor;
-
-	for (; val_cursor + 1 <= val_stop; val_cursor++) {
-		if (*val_cursor >= '0' && *val_cursor <= '9') {
-			value *= 10.0;
-			value += (double) ((int) ((*val_cursor) - '0'));
-		} else if (*val_cursor == '.') {
-			dec_start = val_cursor + 1;
-		} else {
+	n = 0;
+	for (i = tokens[array_i].family.children.first; i != -1; i = tokens[i].family.siblings.next, n++) {
+		if (n == num_values) {
+			return JSMN_ERROR_NOMEM;
+		}
+		start = tokens[i].start;
+		negative = js[start] == '-';
+		if (tokens[i].type == JSMN_PRIMITIVE && tokens[i].flags == JSMN_PRIMITIVE_INTEGER && tokens[i].end - start - negative <= 15) {
+			/* at most 15 digits, below 2^53: exact as a double */
+			if (jsmn_parse_u64(js + start + negative, js + tokens[i].end, &magnitude) == 0) {
+				values[n] = negative ? - (double) magnitude : (double) magnitude;
+				continue;
+			}
+		}
+		if (tokens[i].type != JSMN_PRIMITIVE
+		|| (tokens[i].flags != 0 && tokens[i].flags < JSMN_PRIMITIVE_INTEGER)
+		||  jsmn_parse_double(js + start, js + tokens[i].end, &values[n]) < 0) {
 			break;
 		}
 	}
+	if (i != -1 && stop_i != NULL) {
+		*stop_i = i;
+	}
 
-	if (dec_start == NULL) {
-		decimal = 0;
-	} else {
-		decimal = dec_start - val_cursor;
+	return (jsmnint_t) n;
+}
+jsmnint_t jsmn_dom_get_int64s(jsmn_parser *parser, const char *js, size_t len, jsmntok_t *tokens, jsmnuint_t num_tokens, jsmnint_t array_i, long long *values, size_t num_values, jsmnint_t *stop_i) {
+	jsmnint_t i;
+	size_t n;
+
+	(void) parser;
+	(void) len;
+	if (array_i == -1 || array_i >= (jsmnint_t) num_tokens || tokens[array_i].type != JSMN_ARRAY || values == NULL) {
+		return JSMN_ERROR_INVAL;
+	}
+	if (stop_i != NULL) {
+		*stop_i = -1;
 	}
 
-	if (val_cursor + 2 <= val_stop && (val_cursor[0] == 'e' || val_cursor[0] == 'E') && (val_cursor[1] == '-' || val_cursor[1] == '+')) {
-		if (val_cursor[1] == '-') {
-			e_negative = 1;
+	n = 0;
+	for (i = tokens[array_i].family.children.first; i != -1; i = tokens[i].family.siblings.next, n++) {
+		if (n == num_values) {
+			return JSMN_ERROR_NOMEM;
 		}
-		val_cursor += 2;
-
-		for (; val_cursor + 1 <= val_stop; val_cursor++) {
-			if (*val_cursor >= '0' && *val_cursor <= '9') {
-				exponent *= 10;
-				exponent += (int) ((*val_cursor) - '0');
-			} else {
-				break;
-			}
+		if (tokens[i].type != JSMN_PRIMITIVE
+		|| (tokens[i].flags != 0 && tokens[i].flags != JSMN_PRIMITIVE_INTEGER)
+		||  jsmn_parse_i64(js + tokens[i].start, js + tokens[i].end, &values[n]) < 0) {
+			break;
 		}
 	}
+	if (i != -1 && stop_i != NULL) {
+		*stop_i = i;
+	}
 
-	value    = negative   ? - value    : value;
-	exponent = e_negative ? - exponent : exponent;
-
-	exponent += decimal;
+	return (jsmnint_t) n;
+}
+/*
+ * Shortest round-trip formatting (Ryu).
+ * The interval of decimals that read back as `value` is scaled by a 128-bit power of five,
+ * and digits are dropped while its ends still differ; the result is the shortest decimal
+ * in the interval, closest to `value` when there are several.
+ */
+static int jsmn_pow5bits(int e) {
+	return (int) (((unsigned long) e * 1217359UL) >> 19) + 1;
+}
+static int jsmn_log10_pow2(int e) {
+	return (int) (((unsigned long) e * 78913UL) >> 18);
+}
+static int jsmn_log10_pow5(int e) {
+	return (int) (((unsigned long) e * 732923UL) >> 20);
+}
+static int jsmn_pow5_factor(unsigned long long value) {
+	int count;
 
-	while (exponent > 0) {
-		value *= 10.0;
-		exponent--;
+	for (count = 0; value % 5 == 0; count++) {
+		value /= 5;
 	}
 
-	while (exponent < 0) {
-		value /= 10.0;
-		exponent++;
-	}
+	return count;
+}
+/*
+ * (`m` * `mul`) >> `j`, for a 125-bit `mul` and 64 < `j` < 128.
+ */
+static unsigned long long jsmn_mul_shift64(unsigned long long m, const unsigned long long *mul, int j) {
+	unsigned long long hi0, lo0, hi1, lo1, sum_lo, sum_hi;
 
-	*value_ptr = value;
-#endif
+	jsmn_mul64(m, mul[1], &hi0, &lo0);
+	jsmn_mul64(m, mul[0], &hi1, &lo1);
+	sum_lo = hi0 + lo1;
+	sum_hi = hi1 + (sum_lo < hi0);
+	j -= 64;
 
-	return 0;
+	return (sum_hi << (64 - j)) | (sum_lo >> j);
 }
-int jsmn_dom_new_double(jsmn_parser *parser, char *js, size_t len, jsmntok_t *tokens, unsigned int num_tokens, double value) {
-	char valbuf[32];
-#ifdef USE_LIBC
-	int rc;
+/*
+ * Writes the shortest decimal for a finite `value` into `buf` (at least 26 bytes, not
+ * terminated), in fixed notation for exponents JavaScript would print that way and as
+ * d.ddde[+-]x otherwise. Returns the length.
+ */
+static int jsmn_dtoa(double value, char *buf) {
+	jsmn_double_bits u;
+	unsigned long long m2, mv, vr, vp, vm, output, vr_div, vp_div, vm_div;
+	char digits[20];
+	int ieee_exponent;
+	int e2, e10, q, i, k;
+	int mm_shift;
+	int even;
+	int vm_zeros, vr_zeros;
+	int removed, last_removed, round_up;
+	int olength, point, pos;
+
+	u.value = value;
+	pos = 0;
+	if (u.bits >> 63) {
+		buf[pos++] = '-';
+	}
+	ieee_exponent = (int) (u.bits >> 52) & 0x7FF;
+	m2 = u.bits & 0x000FFFFFFFFFFFFFULL;
+	if (ieee_exponent == 0 && m2 == 0) {
+		buf[pos++] = '0';
+		return pos;
+	}
 
-	rc = snprintf(valbuf, sizeof (valbuf), "%.16g ", value);
-	/*
-	if (value >= 1.0 || value <= -1.0) {
-		rc = snprintf(valbuf, sizeof (valbuf), "%.16f ", value);
+	if (ieee_exponent == 0) {
+		e2 = 1 - 1023 - 52 - 2;
 	} else {
-		rc = snprintf(valbuf, sizeof (valbuf), "%.16g ", value);
+		e2 = ieee_exponent - 1023 - 52 - 2;
+		m2 |= 1ULL << 52;
 	}
-	*/
-	if (rc == -1) {
-		return JSMN_ERROR_INVAL;
+	even     = (m2 & 1) == 0;
+	mv       = 4 * m2;
+	mm_shift = (u.bits & 0x000FFFFFFFFFFFFFULL) != 0 || ieee_exponent <= 1;
+	vm_zeros = 0;
+	vr_zeros = 0;
+
+	/* vr, vp and vm: the value and the ends of its interval, times 10^-e10 */
+	if (e2 >= 0) {
+		q   = jsmn_log10_pow2(e2) - (e2 > 3);
+		e10 = q;
+		k   = POW5_BITS + jsmn_pow5bits(q) - 1;
+		i   = -e2 + q + k;
+		vr  = jsmn_mul_shift64(mv, pow5_inv_split[q], i);
+		vp  = jsmn_mul_shift64(mv + 2, pow5_inv_split[q], i);
+		vm  = jsmn_mul_shift64(mv - 1 - mm_shift, pow5_inv_split[q], i);
+		if (q <= 21) {
+			if (mv % 5 == 0) {
+				vr_zeros = jsmn_pow5_factor(mv) >= q;
+			} else if (even) {
+				vm_zeros = jsmn_pow5_factor(mv - 1 - mm_shift) >= q;
+			} else {
+				vp -= jsmn_pow5_factor(mv + 2) >= q;
+			}
+		}
+	} else {
+		q   = jsmn_log10_pow5(-e2) - (-e2 > 1);
+		e10 = q + e2;
+		i   = -e2 - q;
+		k   = jsmn_pow5bits(i) - POW5_BITS;
+		vr  = jsmn_mul_shift64(mv, pow5_split[i], q - k);
+		vp  = jsmn_mul_shift64(mv + 2, pow5_split[i], q - k);
+		vm  = jsmn_mul_shift64(mv - 1 - mm_shift, pow5_split[i], q - k);
+		if (q <= 1) {
+			vr_zeros = 1;
+			if (even) {
+				vm_zeros = mm_shift == 1;
+			} else {
+				vp--;
+			}
+		} else if (q < 63) {
+			vr_zeros = (mv & ((1ULL << q) - 1)) == 0;
+		}
 	}
-#else
-	int decimal;
-	int pos;
-	int digit;
-	int digits;
 
-	pos = 0;
-	digits = 0;
+	/* drop digits while the interval still holds a shorter decimal */
+	removed = 0;
+	last_removed = 0;
+	if (vm_zeros || vr_zeros) {
+		for (; vp / 10 > vm / 10; removed++) {
+			vm_zeros &= vm % 10 == 0;
+			vr_zeros &= last_removed == 0;
+			last_removed = (int) (vr % 10);
+			vr /= 10;
+			vp /= 10;
+			vm /= 10;
+		}
+		if (vm_zeros) {
+			for (; vm % 10 == 0; removed++) {
+				vr_zeros &= last_removed == 0;
+				last_removed = (int) (vr % 10);
+				vr /= 10;
+				vp /= 10;
+				vm /= 10;
+			}
+		}
+		if (vr_zeros && last_removed == 5 && vr % 2 == 0) {
+			last_removed = 4; /* exactly halfway: round to even */
+		}
+		output = vr + ((vr == vm && (!even || !vm_zeros)) || last_removed >= 5);
+	} else {
+		round_up = 0;
+		vp_div = vp / 100;
+		vm_div = vm / 100;
+		if (vp_div > vm_div) {
+			vr_div = vr / 100;
+			round_up = vr - 100 * vr_div >= 50;
+			vr = vr_div;
+			vp = vp_div;
+			vm = vm_div;
+			removed += 2;
+		}
+		for (; vp / 10 > vm / 10; removed++) {
+			round_up = vr % 10 >= 5;
+			vr /= 10;
+			vp /= 10;
+			vm /= 10;
+		}
+		output = vr + (vr == vm || round_up);
+	}
+	e10 += removed;
 
-	if (value < 0.0) {
-		valbuf[pos++] = '-';
-		value = - value;
+	for (olength = 0; output > 0; olength++) {
+		digits[19 - olength] = (char) ('0' + output % 10);
+		output /= 10;
 	}
+	point = olength + e10; /* value is 0.digits * 10^point */
+	k = 20 - olength;
 
-	if (value < 1.0) {
-		for (decimal = 0; value < 1.0; decimal--, value *= 10.0) {
-			/* pass */
+	if (point >= olength && point <= 21) {
+		for (i = 0; i < olength; i++) {
+			buf[pos++] = digits[k + i];
 		}
-	} else if (value >= 10.0) {
-		for (decimal = 0; value >= 10.0; decimal++, value /= 10.0) {
-			/* pass */
+		for (; i < point; i++) {
+			buf[pos++] = '0';
+		}
+	} else if (point > 0 && point <= 21) {
+		for (i = 0; i < olength; i++) {
+			if (i == point) {
+				buf[pos++] = '.';
+			}
+			buf[pos++] = digits[k + i];
+		}
+	} else if (point > -6 && point <= 0) {
+		buf[pos++] = '0';
+		buf[pos++] = '.';
+		for (i = point; i < 0; i++) {
+			buf[pos++] = '0';
+		}
+		for (i = 0; i < olength; i++) {
+			buf[pos++] = digits[k + i];
 		}
 	} else {
-		/* [1-9][.] */
-		decimal = 0;
-	}
-
-	digit = (int) value;
-	value = value - digit;
-	value *= 10;
-	valbuf[pos++] = '0' + digit;
-	digits++;
-
-	valbuf[pos++] = '.';
-	while (digits <= 16) {
-		digit = (int) value;
-		value = value - digit;
-		value *= 10;
-		valbuf[pos++] = '0' + digit;
-		digits++;
-	}
-	if (decimal != 0) {
-		valbuf[pos++] = 'e';
-		if (decimal < 0) {
-			valbuf[pos++] = '-';
-			decimal = - decimal;
-		} else {
-			valbuf[pos++] = '+';
+		buf[pos++] = digits[k];
+		if (olength > 1) {
+			buf[pos++] = '.';
+			for (i = 1; i < olength; i++) {
+				buf[pos++] = digits[k + i];
+			}
 		}
-
-		if (decimal < 10) {
-			valbuf[pos++] = '0' + ( decimal            );
-		} else if (decimal < 100) {
-			valbuf[pos++] = '0' + ((decimal / 10)  % 10);
-			valbuf[pos++] = '0' + ( decimal        % 10);
+		buf[pos++] = 'e';
+		point--;
+		if (point < 0) {
+			buf[pos++] = '-';
+			point = - point;
 		} else {
-			valbuf[pos++] = '0' + ((decimal / 100) % 10);
-			valbuf[pos++] = '0' + ((decimal / 10)  % 10);
-			valbuf[pos++] = '0' + ( decimal        % 10);
+			buf[pos++] = '+';
+		}
+		if (point >= 100) {
+			buf[pos++] = (char) ('0' + point / 100);
 		}
+		if (point >= 10) {
+			buf[pos++] = (char) ('0' + point / 10 % 10);
+		}
+		buf[pos++] = (char) ('0' + point % 10);
+	}
+
+	return pos;
+}
+jsmnint_t jsmn_dom_new_double(jsmn_parser *parser, char *js, size_t len, jsmntok_t *tokens, jsmnuint_t num_tokens, double value) {
+	jsmn_double_bits u;
+	char valbuf[32];
+	int pos;
+
+	u.value = value;
+	if ((u.bits >> 52 & 0x7FF) == 0x7FF) {
+		return JSMN_ERROR_INVAL; /* JSON has no Infinity or NaN */
 	}
 
+	pos = jsmn_dtoa(value, valbuf);
 	valbuf[pos++] = ' ';
 	valbuf[pos++] = '\0';
-#endif
 
 	return jsmn_dom_new_primitive(parser, js, len, tokens, num_tokens, valbuf);
 }
-int jsmn_dom_new_string(jsmn_parser *parser, char *js, size_t len, jsmntok_t *tokens, unsigned int num_tokens, const char *value) {
-	int i;
-	int rc;
+jsmnint_t jsmn_dom_new_string(jsmn_parser *parser, char *js, size_t len, jsmntok_t *tokens, jsmnuint_t num_tokens, const char *value) {
+	jsmnint_t i;
+	jsmnint_t rc;
 	size_t size;
 
 	size = strlen(value);
@@ -1102,73 +3890,138 @@ int jsmn_dom_new_string(jsmn_parser *parser, char *js, size_t len, jsmntok_t *to
 
 	return i;
 }
+/* A string the parser found to be ASCII without escapes is its own UTF-8 */
+#define JSMN_DOM_PLAIN(t) (((t)->flags & (JSMN_STRING_NOESCAPE | JSMN_STRING_ASCII)) == (JSMN_STRING_NOESCAPE | JSMN_STRING_ASCII))
 /*
- * Returns JSMN_ERROR_INVAL or the length of the UTF-8 string in bytes.
+ * Unescapes the JSON string bytes from `cursor` to `stop` straight into UTF-8, a whole
+ * character at a time while it fits in the `out_len` bytes at `out`. Like UTF8_DECODE and
+ * JSMN_UNQUOTE, bad UTF-8 and unpaired surrogates become U+FFFD.
+ * Returns the number of bytes written, or with `out` NULL the number needed.
  */
-size_t jsmn_dom_get_utf8len(jsmn_parser *parser, const char *js, size_t len, jsmntok_t *tokens, unsigned int num_tokens, int i) {
-	const char *pos_start;
-	const char *pos_cursor;
-	const char *pos_stop;
-
-	wchar_t  q32[1024];
-	wchar_t *q32_start;
-	wchar_t *q32_cursor_out;
-	wchar_t *q32_cursor_in;
-	wchar_t *q32_stop;
+static size_t jsmn_unescape_utf8(const char *cursor, const char *stop, char *out, size_t out_len) {
+	const char *bytes;
+	size_t size;
+	size_t n = 0;
+	wchar_t c;
+	wchar_t low;
+	int l;
+
+	char  enc[8];
+	char *enc_cursor;
+	const wchar_t *c_cursor;
+	const wchar_t *c_stop;
+
+	while (cursor < stop) {
+		/* runs of plain ASCII are copied as they are */
+#ifdef JSMN_SIMD
+		size = jsmn_index_next(cursor, 0, stop - cursor, JSMN_INDEX_ESCAPE);
+#else
+		for (size = 0; cursor + size < stop && cursor[size] != '\\' && (unsigned char) cursor[size] < 0x80; size++);
+#endif
+		if (size > 0) {
+			if (out != NULL) {
+				if (size > out_len - n) {
+					our_memcpy(out + n, cursor, out_len - n);
+					return out_len;
+				}
+				our_memcpy(out + n, cursor, size);
+			}
+			n += size;
+			cursor += size;
+			continue;
+		}
 
-	wchar_t  val32[1024];
-	wchar_t *val32_start;
-	wchar_t *val32_cursor_out;
-	wchar_t *val32_cursor_in;
-	wchar_t *val32_stop;
+		bytes = enc;
+		if (*cursor == '\\') {
+			c = 0xFFFD;
+			if (cursor + 2 > stop) {
+				cursor = stop;
+			} else if (cursor[1] != 'u') {
+				switch (cursor[1]) {
+					case 'b': c = '\b'; break;
+					case 'f': c = '\f'; break;
+					case 'n': c = '\n'; break;
+					case 'r': c = '\r'; break;
+					case 't': c = '\t'; break;
+					default:  c = (unsigned char) cursor[1]; break;
+				}
+				cursor += 2;
+			} else if (cursor + 6 > stop) {
+				cursor = stop;
+			} else {
+				c = JSMN_HEX4DIG(cursor + 2);
+				cursor += 6;
+				if (c >> 10 == 0xD800 >> 10) {
+					/* a high surrogate is only a character with the low one right after it */
+					if (cursor + 6 <= stop && cursor[0] == '\\' && cursor[1] == 'u' &&
+							(low = JSMN_HEX4DIG(cursor + 2)) >> 10 == 0xDC00 >> 10) {
+						c = 0x10000 + (((c % 0x400) << 10) | (low % 0x400));
+						cursor += 6;
+					} else {
+						c = 0xFFFD;
+					}
+				} else if (c >> 10 == 0xDC00 >> 10) {
+					c = 0xFFFD;
+				}
+			}
+		} else {
+			UTF8_CHAR(cursor, stop, c, l);
+			if (l > 0) {
+				/* well-formed UTF-8 is its own encoding */
+				bytes = cursor;
+				size = l;
+				cursor += l;
+			} else {
+				/* a bad or cut short sequence is one U+FFFD up to the next byte that could start one,
+				 * so that it never swallows an escape */
+				c = 0xFFFD;
+				UTF8_BLEN(cursor, l);
+				for (cursor++; --l > 0 && cursor < stop && (*cursor & 0xC0) == 0x80; cursor++);
+			}
+		}
 
-	char  val8[1024];
-	char *val8_start;
-	char *val8_cursor;
-	char *val8_stop;
+		if (bytes == enc) {
+			c_cursor   = &c;
+			c_stop     = &c + 1;
+			enc_cursor = enc;
+			UTF8_ENCODE(c_cursor, c_stop, enc_cursor, enc + sizeof(enc));
+			size = enc_cursor - enc;
+		}
+		if (out != NULL) {
+			if (size > out_len - n) {
+				return n;
+			}
+			our_memcpy(out + n, bytes, size);
+		}
+		n += size;
+	}
 
+	return n;
+}
+/*
+ * Returns JSMN_ERROR_INVAL or the length of the UTF-8 string in bytes.
+ */
+size_t jsmn_dom_get_utf8len(jsmn_parser *parser, const char *js, size_t len, jsmntok_t *tokens, jsmnuint_t num_tokens, jsmnint_t i) {
+	jsmn_dom_cache *entry;
 	size_t utf8len;
 
-	if (i == -1 || i >= (int) num_tokens || tokens[i].end < tokens[i].start) {
+	if (i == -1 || i >= (jsmnint_t) num_tokens || tokens[i].end < tokens[i].start) {
 		return JSMN_ERROR_INVAL;
 	}
 
-	pos_start  = js + tokens[i].start;
-	pos_cursor = pos_start;
-	pos_stop   = js + tokens[i].end;
-
-	q32_start      = q32;
-	q32_cursor_out = q32_start;
-	q32_cursor_in  = q32_start;
-	q32_stop       = q32_start + 1024;
-
-	val32_start      = val32;
-	val32_cursor_out = val32_start;
-	val32_cursor_in  = val32_start;
-	val32_stop       = val32_start + 1024;
-
-	val8_start  = val8;
-	val8_cursor = val8_start;
-	val8_stop   = val8_start + 1024;
-
-	utf8len = 0;
-
-	while (pos_cursor < pos_stop) {
-		UTF8_DECODE(pos_cursor, pos_stop, q32_cursor_out, q32_stop);
-
-		JSMN_UNQUOTE(q32_cursor_in, q32_cursor_out, val32_cursor_out, val32_stop);
-
-		UTF8_ENCODE(val32_cursor_in, val32_cursor_out, val8_cursor, val8_stop);
-
-		utf8len += val8_cursor - val8_start;
-
-		q32_cursor_out = q32_start;
-		q32_cursor_in  = q32_start;
+	if (JSMN_DOM_PLAIN(&tokens[i])) {
+		return tokens[i].end - tokens[i].start;
+	}
 
-		val32_cursor_out = val32_start;
-		val32_cursor_in  = val32_start;
+	entry = jsmn_dom_cached(parser, i);
+	if (entry != NULL && (entry->known & JSMN_DOM_CACHE_UTF8LEN)) {
+		return entry->utf8len;
+	}
 
-		val8_cursor = val8_start;
+	utf8len = jsmn_unescape_utf8(js + tokens[i].start, js + tokens[i].end, NULL, 0);
+	if (entry != NULL) {
+		entry->utf8len = utf8len;
+		entry->known  |= JSMN_DOM_CACHE_UTF8LEN;
 	}
 
 	return utf8len;
@@ -1176,7 +4029,7 @@ size_t jsmn_dom_get_utf8len(jsmn_parser *parser, const char *js, size_t len, jsm
 /*
  * Returns JSMN_ERROR_INVAL or the Unicode character length of the string. This is effectively the UTF-32 element count.
  */
-size_t jsmn_dom_get_utf32len(jsmn_parser *parser, const char *js, size_t len, jsmntok_t *tokens, unsigned int num_tokens, int i) {
+size_t jsmn_dom_get_utf32len(jsmn_parser *parser, const char *js, size_t len, jsmntok_t *tokens, jsmnuint_t num_tokens, jsmnint_t i) {
 	const char *pos_start;
 	const char *pos_cursor;
 	const char *pos_stop;
@@ -1194,10 +4047,17 @@ size_t jsmn_dom_get_utf32len(jsmn_parser *parser, const char *js, size_t len, js
 
 	size_t utf32len;
 
-	if (i == -1 || i >= (int) num_tokens || tokens[i].end < tokens[i].start) {
+	jsmn_dom_cache *entry;
+
+	if (i == -1 || i >= (jsmnint_t) num_tokens || tokens[i].end < tokens[i].start) {
 		return JSMN_ERROR_INVAL;
 	}
 
+	entry = jsmn_dom_cached(parser, i);
+	if (entry != NULL && (entry->known & JSMN_DOM_CACHE_UTF32LEN)) {
+		return entry->utf32len;
+	}
+
 	pos_start  = js + tokens[i].start;
 	pos_cursor = pos_start;
 	pos_stop   = js + tokens[i].end;
@@ -1213,97 +4073,66 @@ size_t jsmn_dom_get_utf32len(jsmn_parser *parser, const char *js, size_t len, js
 
 	utf32len = 0;
 
-	while (pos_cursor < pos_stop) {
-		UTF8_DECODE(pos_cursor, pos_stop, q32_cursor_out, q32_stop);
-
-		JSMN_UNQUOTE(q32_cursor_in, q32_cursor_out, val32_cursor, val32_stop);
-
-		utf32len += val32_cursor - val32_start;
-
-		q32_cursor_out = q32_start;
-		q32_cursor_in  = q32_start;
-
-		val32_cursor = val32_start;
-	}
-
-	return utf32len;
-}
-/*
- * Returns JSMN_ERROR_INVAL or the number of bytes written into val8.
- * val8 is always NULL-terminated. val8_len >= 1 is required, ensuring this property.
- */
-int jsmn_dom_get_utf8(jsmn_parser *parser, const char *js, size_t len, jsmntok_t *tokens, unsigned int num_tokens, int i, char *val8, size_t val8_len) {
-	const char *pos_start;
-	const char *pos_cursor;
-	const char *pos_stop;
-
-	wchar_t  q32[1024];
-	wchar_t *q32_start;
-	wchar_t *q32_cursor_out;
-	wchar_t *q32_cursor_in;
-	wchar_t *q32_stop;
-
-	wchar_t  val32[1024];
-	wchar_t *val32_start;
-	wchar_t *val32_cursor_out;
-	wchar_t *val32_cursor_in;
-	wchar_t *val32_stop;
-
-	char *val8_start;
-	char *val8_cursor;
-	char *val8_stop;
-
-	if (i == -1 || i >= (int) num_tokens || tokens[i].end < tokens[i].start || val8_len < 1) {
-		return JSMN_ERROR_INVAL;
-	}
-
-	pos_start  = js + tokens[i].start;
-	pos_cursor = pos_start;
-	pos_stop   = js + tokens[i].end;
-
-	q32_start = q32;
-	q32_cursor_out = q32_start;
-	q32_cursor_in  = q32_start;
-	q32_stop       = q32_start + 1024;
-
-	val32_start      = val32;
-	val32_cursor_out = val32_start;
-	val32_cursor_in  = val32_start;
-	val32_stop       = val32_start + 1024;
-
-	val8_start  = val8;
-	val8_cursor = val8_start;
-	val8_stop   = val8_start + val8_len;
-
-	while (pos_cursor < pos_stop && val8_cursor < val8_stop) {
+	while (pos_cursor < pos_stop) {
 		UTF8_DECODE(pos_cursor, pos_stop, q32_cursor_out, q32_stop);
 
-		JSMN_UNQUOTE(q32_cursor_in, q32_cursor_out, val32_cursor_out, val32_stop);
+		JSMN_UNQUOTE(q32_cursor_in, q32_cursor_out, val32_cursor, val32_stop);
 
-		UTF8_ENCODE(val32_cursor_in, val32_cursor_out, val8_cursor, val8_stop);
+		utf32len += val32_cursor - val32_start;
 
 		q32_cursor_out = q32_start;
 		q32_cursor_in  = q32_start;
 
-		val32_cursor_out = val32_start;
-		val32_cursor_in  = val32_start;
+		val32_cursor = val32_start;
+	}
+
+	if (entry != NULL) {
+		entry->utf32len = utf32len;
+		entry->known   |= JSMN_DOM_CACHE_UTF32LEN;
 	}
 
-	if (val8_cursor < val8_stop) {
-		*val8_cursor = '\0';
-	} else if (val8_cursor == val8_stop) {
-		*(--val8_cursor) = '\0';
-	} else {
+	return utf32len;
+}
+/*
+ * Returns JSMN_ERROR_INVAL or the number of bytes written into val8.
+ * val8 is always NULL-terminated. val8_len >= 1 is required, ensuring this property.
+ * A string too long for val8 is cut after the last whole character that fits.
+ */
+jsmnint_t jsmn_dom_get_utf8(jsmn_parser *parser, const char *js, size_t len, jsmntok_t *tokens, jsmnuint_t num_tokens, jsmnint_t i, char *val8, size_t val8_len) {
+	jsmn_dom_cache *entry;
+	size_t size;
+
+	if (i == -1 || i >= (jsmnint_t) num_tokens || tokens[i].end < tokens[i].start || val8_len < 1) {
 		return JSMN_ERROR_INVAL;
 	}
 
-	return val8_cursor - val8_start;
+	if (JSMN_DOM_PLAIN(&tokens[i])) {
+		size = tokens[i].end - tokens[i].start;
+		if (size > val8_len - 1) {
+			size = val8_len - 1;
+		}
+		our_memcpy(val8, js + tokens[i].start, size);
+		val8[size] = '\0';
+		return size;
+	}
+
+	size = jsmn_unescape_utf8(js + tokens[i].start, js + tokens[i].end, val8, val8_len - 1);
+	val8[size] = '\0';
+
+	/* with room for a character more, the whole string was written */
+	entry = jsmn_dom_cached(parser, i);
+	if (entry != NULL && size + 4 < val8_len) {
+		entry->utf8len = size;
+		entry->known  |= JSMN_DOM_CACHE_UTF8LEN;
+	}
+
+	return size;
 }
 /*
  * Returns JSMN_ERROR_INVAL or the number of characters written into val32.
  * val32 is always NULL-terminated. val32_len >= 1 is required, ensuring this property.
  */
-int jsmn_dom_get_utf32(jsmn_parser *parser, const char *js, size_t len, jsmntok_t *tokens, unsigned int num_tokens, int i, wchar_t *val32, size_t val32_len) {
+jsmnint_t jsmn_dom_get_utf32(jsmn_parser *parser, const char *js, size_t len, jsmntok_t *tokens, jsmnuint_t num_tokens, jsmnint_t i, wchar_t *val32, size_t val32_len) {
 	const char *pos_start;
 	const char *pos_cursor;
 	const char *pos_stop;
@@ -1318,7 +4147,7 @@ int jsmn_dom_get_utf32(jsmn_parser *parser, const char *js, size_t len, jsmntok_
 	wchar_t *val32_cursor;
 	wchar_t *val32_stop;
 
-	if (i == -1 || i >= (int) num_tokens || tokens[i].end < tokens[i].start || val32_len < 1) {
+	if (i == -1 || i >= (jsmnint_t) num_tokens || tokens[i].end < tokens[i].start || val32_len < 1) {
 		return JSMN_ERROR_INVAL;
 	}
 
@@ -1354,9 +4183,74 @@ int jsmn_dom_get_utf32(jsmn_parser *parser, const char *js, size_t len, jsmntok_
 
 	return val32_cursor - val32_start;
 }
-int jsmn_dom_new_utf8(jsmn_parser *parser, char *js, size_t len, jsmntok_t *tokens, unsigned int num_tokens, const char *val8, size_t val8_len) {
-	int i;
-	int rc;
+/*
+ * Quotes the UTF-8 bytes from `cursor` to `stop` into a JSON string body at `*out`, like
+ * JSMN_QUOTE_ASCII: '"', '\\' and control bytes are escaped, runs of other bytes copied
+ * as they are. Stops where the next byte or escape would pass `out_stop`.
+ * Returns how far into the bytes it got.
+ */
+static const char *jsmn_quote_utf8(const char *cursor, const char *stop, char **out, char *out_stop) {
+	char *qc = *out;
+	char  c;
+#ifdef JSMN_VEC_SIZE
+	unsigned int mask;
+	size_t size;
+#endif
+
+	while (cursor < stop && qc < out_stop) {
+#ifdef JSMN_VEC_SIZE
+		/* a whole vector is copied, and the cursors moved up to the first byte to escape */
+		if (cursor + JSMN_VEC_SIZE <= stop && qc + JSMN_VEC_SIZE <= out_stop) {
+			mask = jsmn_index_vec(cursor, JSMN_INDEX_QUOTE);
+			JSMN_VEC_STORE(qc, JSMN_VEC_LOAD(cursor));
+			size = mask == 0 ? JSMN_VEC_SIZE : (size_t) JSMN_CTZ(mask);
+			qc     += size;
+			cursor += size;
+			if (mask == 0) {
+				continue;
+			}
+		}
+#endif
+		if ((unsigned char) *cursor >= 0x20 && *cursor != '"' && *cursor != '\\') {
+			*(qc++) = *(cursor++);
+			continue;
+		}
+
+		switch (*cursor) {
+			case '"':  c = '"';  break;
+			case '\\': c = '\\'; break;
+			case '\b': c = 'b';  break;
+			case '\f': c = 'f';  break;
+			case '\n': c = 'n';  break;
+			case '\r': c = 'r';  break;
+			case '\t': c = 't';  break;
+			default:   c = '\0'; break;
+		}
+		if (c != '\0') {
+			if (qc + 2 > out_stop) {
+				break;
+			}
+			qc[0] = '\\';
+			qc[1] = c;
+			qc += 2;
+		} else {
+			if (qc + 6 > out_stop) {
+				break;
+			}
+			qc[0] = '\\';
+			qc[1] = 'u';
+			JSMN_EMIT_HEX4DIG(qc + 2, *cursor);
+			qc += 6;
+		}
+		cursor++;
+	}
+
+	*out = qc;
+	return cursor;
+}
+jsmnint_t jsmn_dom_new_utf8(jsmn_parser *parser, char *js, size_t len, jsmntok_t *tokens, jsmnuint_t num_tokens, const char *val8, size_t val8_len) {
+	jsmnint_t i;
+	jsmnint_t rc;
 
 	char *pos_start;
 	char *pos_cursor;
@@ -1382,7 +4276,7 @@ int jsmn_dom_new_utf8(jsmn_parser *parser, char *js, size_t len, jsmntok_t *toke
 		return JSMN_ERROR_NOMEM;
 	}
 
-	JSMN_QUOTE_ASCII(val8_cursor, val8_stop, pos_cursor, pos_stop);
+	val8_cursor = jsmn_quote_utf8(val8_cursor, val8_stop, &pos_cursor, pos_stop);
 	if (val8_cursor < val8_stop) {
 		return JSMN_ERROR_NOMEM;
 	}
@@ -1403,9 +4297,9 @@ int jsmn_dom_new_utf8(jsmn_parser *parser, char *js, size_t len, jsmntok_t *toke
 	
 	return i;
 }
-int jsmn_dom_new_utf32(jsmn_parser *parser, char *js, size_t len, jsmntok_t *tokens, unsigned int num_tokens, const wchar_t *val32, size_t val32_len) {
-	int i;
-	int rc;
+jsmnint_t jsmn_dom_new_utf32(jsmn_parser *parser, char *js, size_t len, jsmntok_t *tokens, jsmnuint_t num_tokens, const wchar_t *val32, size_t val32_len) {
+	jsmnint_t i;
+	jsmnint_t rc;
 
 	char *pos_start;
 	char *pos_cursor;
@@ -1414,7 +4308,7 @@ int jsmn_dom_new_utf32(jsmn_parser *parser, char *js, size_t len, jsmntok_t *tok
 	char  val8[1024];
 	char *val8_start;
 	char *val8_cursor_out;
-	char *val8_cursor_in;
+	const char *val8_cursor_in;
 	char *val8_stop;
 
 	const wchar_t *val32_cursor;
@@ -1446,7 +4340,7 @@ int jsmn_dom_new_utf32(jsmn_parser *parser, char *js, size_t len, jsmntok_t *tok
 	while (val32_cursor < val32_stop && pos_cursor < pos_stop) {
 		UTF8_ENCODE(val32_cursor, val32_stop, val8_cursor_out, val8_stop);
 
-		JSMN_QUOTE_ASCII(val8_cursor_in, val8_cursor_out, pos_cursor, pos_stop);
+		val8_cursor_in = jsmn_quote_utf8(val8_cursor_in, val8_cursor_out, &pos_cursor, pos_stop);
 		if (val8_cursor_in < val8_cursor_out) {
 			return JSMN_ERROR_NOMEM;
 		}
@@ -1471,9 +4365,9 @@ int jsmn_dom_new_utf32(jsmn_parser *parser, char *js, size_t len, jsmntok_t *tok
 	
 	return i;
 }
-int jsmn_dom_eval(jsmn_parser *parser, char *js, size_t len, jsmntok_t *tokens, unsigned int num_tokens, const char *value) {
-	int i;
-	int rc;
+jsmnint_t jsmn_dom_eval(jsmn_parser *parser, char *js, size_t len, jsmntok_t *tokens, jsmnuint_t num_tokens, const char *value) {
+	jsmnint_t i;
+	jsmnint_t rc;
 	size_t size;
 
 	size = strlen(value);
@@ -1490,46 +4384,205 @@ int jsmn_dom_eval(jsmn_parser *parser, char *js, size_t len, jsmntok_t *tokens,
 	if (rc < 0) {
 		return rc;
 	}
+	/* not from the input: emit it the way the rest of the tree is emitted */
+	jsmn_dom_touch(tokens, num_tokens, i);
 
 	return i;
 }
 #define NAME_CMP_SIZE 1024
-int jsmn_dom_get_utf8_name(jsmn_parser *parser, const char *js, size_t len, jsmntok_t *tokens, unsigned int num_tokens, int object_i, char *utf8_name, size_t utf8_len) {
-	int rc;
-	int dom_i;
+#define JSMN_DOM_SLOT_EMPTY   -1
+#define JSMN_DOM_SLOT_DELETED -2
+/*
+ * Points `*name` at the unquoted UTF-8 bytes of name token `i`: into `js` itself when it
+ * has no escapes, otherwise into `buf`. Returns their length or JSMN_ERROR_INVAL.
+ */
+static jsmnint_t jsmn_dom_name(jsmn_parser *parser, const char *js, size_t len, jsmntok_t *tokens, jsmnuint_t num_tokens, jsmnint_t i, const char **name, char *buf) {
+	jsmnint_t k;
+	jsmnint_t rc;
+
+	if (tokens[i].end < tokens[i].start) {
+		return JSMN_ERROR_INVAL;
+	}
+
+	for (k = tokens[i].start; !(tokens[i].flags & JSMN_STRING_NOESCAPE) && k < tokens[i].end; k++) {
+		if (js[k] == '\\') {
+			rc = jsmn_dom_get_utf8(parser, js, len, tokens, num_tokens, i, buf, NAME_CMP_SIZE);
+			if (rc < 0 || rc >= NAME_CMP_SIZE - 1) {
+				return JSMN_ERROR_INVAL;
+			}
+			*name = buf;
+			return rc;
+		}
+	}
+
+	*name = js + tokens[i].start;
+	return tokens[i].end - tokens[i].start;
+}
+/*
+ * FNV-1a over a name, reduced to a slot.
+ */
+static jsmnuint_t jsmn_dom_hash(const char *name, size_t name_len, jsmnuint_t num_slots) {
+	unsigned long h = 2166136261UL;
+
+	while (name_len-- > 0) {
+		h ^= (unsigned char) *name++;
+		h *= 16777619UL;
+	}
+
+	return (jsmnuint_t) (h ^ (h >> 16)) & (num_slots - 1);
+}
+static jsmn_dom_index *jsmn_dom_get_index(jsmn_parser *parser, jsmnint_t object_i) {
+	jsmn_dom_index *index;
+
+	for (index = parser->indexes; index != NULL; index = index->next) {
+		if (index->object_i == object_i) {
+			return index;
+		}
+	}
+
+	return NULL;
+}
+/*
+ * Adds name token `i` to the index, or detaches the index when it would be more than half full.
+ * Slots of deleted names are not reused, so that duplicate names keep their sibling order.
+ */
+static void jsmn_dom_index_add(jsmn_parser *parser, jsmntok_t *tokens, jsmnuint_t num_tokens, jsmn_dom_index *index, jsmnint_t i) {
+	const char *name;
+	char val8[NAME_CMP_SIZE];
+	jsmnint_t rc;
+	jsmnuint_t slot;
+
+	if ((index->used + 1) * 2 > index->num_slots) {
+		jsmn_dom_unindex_object(parser, index);
+		return;
+	}
+
+	rc = jsmn_dom_name(parser, index->js, index->len, tokens, num_tokens, i, &name, val8);
+	if (rc < 0) {
+		/* No lookup can match it */
+		return;
+	}
+
+	slot = jsmn_dom_hash(name, rc, index->num_slots);
+	while (index->slots[slot] != JSMN_DOM_SLOT_EMPTY) {
+		slot = (slot + 1) & (index->num_slots - 1);
+	}
+	index->slots[slot] = i;
+	index->used++;
+}
+static void jsmn_dom_index_remove(jsmn_parser *parser, jsmntok_t *tokens, jsmnuint_t num_tokens, jsmn_dom_index *index, jsmnint_t i) {
+	const char *name;
+	char val8[NAME_CMP_SIZE];
+	jsmnint_t rc;
+	jsmnuint_t slot;
+
+	rc = jsmn_dom_name(parser, index->js, index->len, tokens, num_tokens, i, &name, val8);
+	if (rc < 0) {
+		return;
+	}
+
+	slot = jsmn_dom_hash(name, rc, index->num_slots);
+	while (index->slots[slot] != JSMN_DOM_SLOT_EMPTY) {
+		if (index->slots[slot] == i) {
+			index->slots[slot] = JSMN_DOM_SLOT_DELETED;
+			return;
+		}
+		slot = (slot + 1) & (index->num_slots - 1);
+	}
+}
+int jsmn_dom_index_object(jsmn_parser *parser, const char *js, size_t len, jsmntok_t *tokens, jsmnuint_t num_tokens, jsmnint_t object_i, jsmn_dom_index *index, jsmnint_t *slots, jsmnuint_t num_slots) {
+	jsmnint_t dom_i;
+	jsmnuint_t slot;
+
+	if (jsmn_dom_get_type(parser, tokens, num_tokens, object_i) != JSMN_OBJECT || num_slots == 0 || (num_slots & (num_slots - 1)) != 0) {
+		return JSMN_ERROR_INVAL;
+	}
 
+	if (jsmn_dom_get_count(parser, tokens, num_tokens, object_i) * 2 > num_slots) {
+		return JSMN_ERROR_NOMEM;
+	}
+
+	/* One index per object */
+	if (jsmn_dom_get_index(parser, object_i) != NULL) {
+		jsmn_dom_unindex_object(parser, jsmn_dom_get_index(parser, object_i));
+	}
+
+	index->object_i  = object_i;
+	index->js        = js;
+	index->len       = len;
+	index->slots     = slots;
+	index->num_slots = num_slots;
+	index->used      = 0;
+	for (slot = 0; slot < num_slots; slot++) {
+		slots[slot] = JSMN_DOM_SLOT_EMPTY;
+	}
+
+	dom_i = jsmn_dom_get_child(parser, tokens, num_tokens, object_i);
+	while (dom_i != -1) {
+		jsmn_dom_index_add(parser, tokens, num_tokens, index, dom_i);
+		dom_i = jsmn_dom_get_sibling(parser, tokens, num_tokens, dom_i);
+	}
+
+	index->next = parser->indexes;
+	parser->indexes = index;
+
+	return 0;
+}
+void jsmn_dom_unindex_object(jsmn_parser *parser, jsmn_dom_index *index) {
+	jsmn_dom_index **link;
+
+	for (link = &parser->indexes; *link != NULL; link = &(*link)->next) {
+		if (*link == index) {
+			*link = index->next;
+			index->next = NULL;
+			return;
+		}
+	}
+}
+jsmnint_t jsmn_dom_get_utf8_name(jsmn_parser *parser, const char *js, size_t len, jsmntok_t *tokens, jsmnuint_t num_tokens, jsmnint_t object_i, char *utf8_name, size_t utf8_len) {
+	jsmnint_t rc;
+	jsmnint_t dom_i;
+	jsmn_dom_index *index;
+	jsmnuint_t slot;
+
+	const char *name;
 	char val8[NAME_CMP_SIZE];
 
 	if (utf8_len >= NAME_CMP_SIZE || jsmn_dom_get_type(parser, tokens, num_tokens, object_i) != JSMN_OBJECT) {
-		/* fprintf(stderr, "1\n"); */
+		return -1;
+	}
+
+	index = jsmn_dom_get_index(parser, object_i);
+	if (index != NULL) {
+		slot = jsmn_dom_hash(utf8_name, utf8_len, index->num_slots);
+		while (index->slots[slot] != JSMN_DOM_SLOT_EMPTY) {
+			dom_i = index->slots[slot];
+			if (dom_i >= 0) {
+				rc = jsmn_dom_name(parser, js, len, tokens, num_tokens, dom_i, &name, val8);
+				if (rc == (jsmnint_t) utf8_len && our_memcmp((void *) name, (void *) utf8_name, utf8_len) == 0) {
+					return dom_i;
+				}
+			}
+			slot = (slot + 1) & (index->num_slots - 1);
+		}
 		return -1;
 	}
 
 	dom_i = jsmn_dom_get_child(parser, tokens, num_tokens, object_i);
 	while (dom_i != -1) {
-		rc = jsmn_dom_get_utf8(parser, js, len, tokens, num_tokens, dom_i, val8, sizeof(val8));
-		if (rc < 0 || rc >= NAME_CMP_SIZE) {
-			/* fprintf(stderr, "2\n"); */
-			return -1;
-		}
-
-		/*
-		fprintf(stderr, "candidate[%i]: %s\n", rc, val8);
-		fprintf(stderr, "target   [%zu]: %s\n", utf8_len, utf8_name);
-		*/
-		if (rc == utf8_len && our_memcmp((void *) val8, (void *) utf8_name, utf8_len) == 0) {
-			/* fprintf(stderr, "3\n"); */
+		/* Names without escapes are compared in place */
+		rc = jsmn_dom_name(parser, js, len, tokens, num_tokens, dom_i, &name, val8);
+		if (rc == (jsmnint_t) utf8_len && our_memcmp((void *) name, (void *) utf8_name, utf8_len) == 0) {
 			return dom_i;
 		}
 
 		dom_i = jsmn_dom_get_sibling(parser, tokens, num_tokens, dom_i);
 	}
 
-	/* fprintf(stderr, "4\n"); */
 	return -1;
 }
-int jsmn_dom_get_by_utf8_name(jsmn_parser *parser, const char *js, size_t len, jsmntok_t *tokens, unsigned int num_tokens, int object_i, char *utf8_name, size_t utf8_len) {
-	int dom_i;
+jsmnint_t jsmn_dom_get_by_utf8_name(jsmn_parser *parser, const char *js, size_t len, jsmntok_t *tokens, jsmnuint_t num_tokens, jsmnint_t object_i, char *utf8_name, size_t utf8_len) {
+	jsmnint_t dom_i;
 
 	dom_i = jsmn_dom_get_utf8_name(parser, js, len, tokens, num_tokens, object_i, utf8_name, utf8_len);
 	if (dom_i < 0) {
@@ -1538,10 +4591,11 @@ int jsmn_dom_get_by_utf8_name(jsmn_parser *parser, const char *js, size_t len, j
 
 	return jsmn_dom_get_child(parser, tokens, num_tokens, dom_i);
 }
-int jsmn_dom_insert_name(jsmn_parser *parser, jsmntok_t *tokens, unsigned int num_tokens, int object_i, int name_i, int value_i) {
-	int rc;
+int jsmn_dom_insert_name(jsmn_parser *parser, jsmntok_t *tokens, jsmnuint_t num_tokens, jsmnint_t object_i, jsmnint_t name_i, jsmnint_t value_i) {
+	jsmnint_t rc;
+	jsmn_dom_index *index;
 
-	if (object_i == -1 || object_i >= (int) num_tokens || name_i == -1 || name_i >= (int) num_tokens || value_i == -1 || value_i >= (int) num_tokens) {
+	if (object_i == -1 || object_i >= (jsmnint_t) num_tokens || name_i == -1 || name_i >= (jsmnint_t) num_tokens || value_i == -1 || value_i >= (jsmnint_t) num_tokens) {
 		return JSMN_ERROR_INVAL;
 	}
 
@@ -1559,12 +4613,17 @@ int jsmn_dom_insert_name(jsmn_parser *parser, jsmntok_t *tokens, unsigned int nu
 		return rc;
 	}
 
+	index = jsmn_dom_get_index(parser, object_i);
+	if (index != NULL) {
+		jsmn_dom_index_add(parser, tokens, num_tokens, index, name_i);
+	}
+
 	return 0;
 }
-int jsmn_dom_insert_value(jsmn_parser *parser, jsmntok_t *tokens, unsigned int num_tokens, int array_i, int value_i) {
-	int rc;
+int jsmn_dom_insert_value(jsmn_parser *parser, jsmntok_t *tokens, jsmnuint_t num_tokens, jsmnint_t array_i, jsmnint_t value_i) {
+	jsmnint_t rc;
 
-	if (array_i == -1 || array_i >= (int) num_tokens || value_i == -1 || value_i >= (int) num_tokens) {
+	if (array_i == -1 || array_i >= (jsmnint_t) num_tokens || value_i == -1 || value_i >= (jsmnint_t) num_tokens) {
 		return JSMN_ERROR_INVAL;
 	}
 
@@ -1579,10 +4638,11 @@ int jsmn_dom_insert_value(jsmn_parser *parser, jsmntok_t *tokens, unsigned int n
 
 	return 0;
 }
-int jsmn_dom_delete_name(jsmn_parser *parser, jsmntok_t *tokens, unsigned int num_tokens, int object_i, int name_i) {
-	int rc;
+int jsmn_dom_delete_name(jsmn_parser *parser, jsmntok_t *tokens, jsmnuint_t num_tokens, jsmnint_t object_i, jsmnint_t name_i) {
+	jsmnint_t rc;
+	jsmn_dom_index *index;
 
-	if (object_i == -1 || object_i >= (int) num_tokens || name_i == -1 || name_i >= (int) num_tokens) {
+	if (object_i == -1 || object_i >= (jsmnint_t) num_tokens || name_i == -1 || name_i >= (jsmnint_t) num_tokens) {
 		return JSMN_ERROR_INVAL;
 	}
 
@@ -1590,6 +4650,11 @@ int jsmn_dom_delete_name(jsmn_parser *parser, jsmntok_t *tokens, unsigned int nu
 		return JSMN_ERROR_INVAL;
 	}
 
+	index = jsmn_dom_get_index(parser, object_i);
+	if (index != NULL) {
+		jsmn_dom_index_remove(parser, tokens, num_tokens, index, name_i);
+	}
+
 	rc = jsmn_dom_delete(parser, tokens, num_tokens, name_i);
 	if (rc < 0) {
 		return rc;
@@ -1597,10 +4662,10 @@ int jsmn_dom_delete_name(jsmn_parser *parser, jsmntok_t *tokens, unsigned int nu
 
 	return 0;
 }
-int jsmn_dom_delete_value(jsmn_parser *parser, jsmntok_t *tokens, unsigned int num_tokens, int array_i, int value_i) {
-	int rc;
+int jsmn_dom_delete_value(jsmn_parser *parser, jsmntok_t *tokens, jsmnuint_t num_tokens, jsmnint_t array_i, jsmnint_t value_i) {
+	jsmnint_t rc;
 
-	if (array_i == -1 || array_i >= (int) num_tokens || value_i == -1 || value_i >= (int) num_tokens) {
+	if (array_i == -1 || array_i >= (jsmnint_t) num_tokens || value_i == -1 || value_i >= (jsmnint_t) num_tokens) {
 		return JSMN_ERROR_INVAL;
 	}
 
@@ -1619,28 +4684,30 @@ int jsmn_dom_delete_value(jsmn_parser *parser, jsmntok_t *tokens, unsigned int n
 
 #ifdef JSMN_EMITTER
 
-void jsmn_emit_seek(jsmn_emitter *emitter, int object_i) {
+void jsmn_emit_seek(jsmn_emitter *emitter, jsmnint_t object_i) {
 	emitter->cursor_i = object_i;
 	emitter->cursor_phase = PHASE_UNOPENED;
+	emitter->cursor_pos = 0;
 }
 
 void jsmn_init_emitter(jsmn_emitter *emitter) {
 	jsmn_emit_seek(emitter, 0);
 }
 
-int jsmn_emit_token(jsmn_parser *parser, char *js, size_t len, jsmntok_t *tokens, unsigned int num_tokens, jsmn_emitter *emitter, char *outjs, size_t outlen) {
+jsmnint_t jsmn_emit_token(jsmn_parser *parser, char *js, size_t len, jsmntok_t *tokens, jsmnuint_t num_tokens, jsmn_emitter *emitter, char *outjs, size_t outlen) {
 	size_t pos;
 
-	int        parent_i;
-	int        sibling_i;
-	int        child_i;
+	jsmnint_t  parent_i;
+	jsmnint_t  sibling_i;
+	jsmnint_t  child_i;
 
-	int        start;
+	jsmnint_t  start;
 	size_t     value_len;
+	size_t     copy_len;
 	jsmntype_t type;
 	jsmntype_t parent_type;
 
-	int           next_i;
+	jsmnint_t     next_i;
 	enum tokphase next_phase;
 
 	pos = 0;
@@ -1664,6 +4731,27 @@ int jsmn_emit_token(jsmn_parser *parser, char *js, size_t len, jsmntok_t *tokens
 		case JSMN_ARRAY:
 			switch (emitter->cursor_phase) {
 				case PHASE_UNOPENED:
+					/* untouched since it was parsed: its original text is its value, copied
+					 * across as many calls as it takes so the buffer size never changes the output */
+					if (!(tokens[emitter->cursor_i].flags & JSMN_DOM_DIRTY) && value_len > 0) {
+						if (outlen - pos <= 1) {
+							break;
+						}
+						copy_len = value_len - emitter->cursor_pos;
+						if (copy_len > outlen - pos - 1) {
+							copy_len = outlen - pos - 1;
+						}
+						our_memcpy(&outjs[pos], &js[start + emitter->cursor_pos], copy_len);
+						pos += copy_len;
+						outjs[pos] = '\0';
+						emitter->cursor_pos += copy_len;
+						if (emitter->cursor_pos < value_len) {
+							break;
+						}
+						emitter->cursor_pos = 0;
+						emitter->cursor_phase = PHASE_CLOSED;
+						goto closed;
+					}
 					if (outlen - pos > 1) {
 						outjs[pos++] = type == JSMN_OBJECT ? '{' : '[';
 						outjs[pos] = '\0';
@@ -1687,6 +4775,7 @@ int jsmn_emit_token(jsmn_parser *parser, char *js, size_t len, jsmntok_t *tokens
 					}
 					emitter->cursor_phase = PHASE_CLOSED;
 				case PHASE_CLOSED:
+				closed:
 					if (sibling_i != -1) {
 						if (outlen - pos > 2) {
 							outjs[pos++] = ',';
@@ -1808,10 +4897,10 @@ int jsmn_emit_token(jsmn_parser *parser, char *js, size_t len, jsmntok_t *tokens
 	return pos;
 }
 
-int jsmn_emit(jsmn_parser *parser, char *js, size_t len,
-		jsmntok_t *tokens, unsigned int num_tokens,
+jsmnint_t jsmn_emit(jsmn_parser *parser, char *js, size_t len,
+		jsmntok_t *tokens, jsmnuint_t num_tokens,
 		jsmn_emitter *emitter, char *outjs, size_t outlen) {
-	int rc;
+	jsmnint_t rc;
 	size_t pos;
 	jsmn_emitter prior_emitter;
 	
@@ -1838,4 +4927,310 @@ int jsmn_emit(jsmn_parser *parser, char *js, size_t len,
 
 	return pos;
 }
+
+#ifdef JSMN_EMIT_IOV
+typedef struct {
+	struct iovec *iov;
+	int           iovcnt;
+	int           n;
+	char         *scratch;
+	size_t        scratch_len;
+	size_t        used;
+	int           full;
+} jsmn_iov_out;
+/*
+ * Appends the `size` bytes at `p`, into the last entry when they follow on from it.
+ * Sets `full` when there is no entry left for them.
+ */
+static void jsmn_iov_put(jsmn_iov_out *out, const char *p, size_t size) {
+	struct iovec *last;
+
+	if (size == 0 || out->full) {
+		return;
+	}
+
+	if (out->n > 0) {
+		last = &out->iov[out->n - 1];
+		if ((const char *) last->iov_base + last->iov_len == p) {
+			last->iov_len += size;
+			return;
+		}
+	}
+	if (out->n == out->iovcnt) {
+		out->full = 1;
+		return;
+	}
+	out->iov[out->n].iov_base = (void *) p;
+	out->iov[out->n].iov_len  = size;
+	out->n++;
+}
+/*
+ * Appends punctuation, copied into the scratch area.
+ */
+static void jsmn_iov_punct(jsmn_iov_out *out, const char *p, size_t size) {
+	if (out->full || out->scratch_len - out->used < size) {
+		out->full = 1;
+		return;
+	}
+
+	our_memcpy(&out->scratch[out->used], p, size);
+	jsmn_iov_put(out, &out->scratch[out->used], size);
+	out->used += size;
+}
+/*
+ * Appends a string with its quotes, taking each from `js` when it is there and from scratch
+ * only when it is not.
+ */
+static void jsmn_iov_string(jsmn_iov_out *out, const char *js, size_t len, jsmnint_t start, size_t size) {
+	if (start > 0 && js[start - 1] == '\"') {
+		jsmn_iov_put(out, &js[start - 1], size + 1);
+	} else {
+		jsmn_iov_punct(out, "\"", 1);
+		jsmn_iov_put(  out, &js[start], size);
+	}
+	if ((size_t) start + size < len && js[start + size] == '\"') {
+		jsmn_iov_put(out, &js[start + size], 1);
+	} else {
+		jsmn_iov_punct(out, "\"", 1);
+	}
+}
+int jsmn_emit_iov(jsmn_parser *parser, const char *js, size_t len,
+		jsmntok_t *tokens, jsmnuint_t num_tokens,
+		jsmn_emitter *emitter, struct iovec *iov, int iovcnt, char *scratch, size_t scratch_len) {
+	jsmn_iov_out out;
+	jsmn_emitter prior_emitter;
+	int          prior_n;
+	size_t       prior_used;
+	size_t       prior_last_len;
+
+	jsmnint_t  parent_i;
+	jsmnint_t  sibling_i;
+	jsmnint_t  child_i;
+
+	jsmnint_t  start;
+	size_t     value_len;
+	jsmntype_t type;
+
+	out.iov         = iov;
+	out.iovcnt      = iovcnt;
+	out.n           = 0;
+	out.scratch     = scratch;
+	out.scratch_len = scratch_len;
+	out.used        = 0;
+	out.full        = 0;
+
+	/* one step at a time; a step that does not fit is undone and left for the next call */
+	while (emitter->cursor_i != -1) {
+		prior_emitter  = *emitter;
+		prior_n        = out.n;
+		prior_used     = out.used;
+		prior_last_len = out.n > 0 ? iov[out.n - 1].iov_len : 0;
+
+		parent_i  = jsmn_dom_get_parent( parser, tokens, num_tokens, emitter->cursor_i);
+		sibling_i = jsmn_dom_get_sibling(parser, tokens, num_tokens, emitter->cursor_i);
+		child_i   = jsmn_dom_get_child(  parser, tokens, num_tokens, emitter->cursor_i);
+
+		start     = jsmn_dom_get_start(  parser, tokens, num_tokens, emitter->cursor_i);
+		value_len = jsmn_dom_get_strlen( parser, tokens, num_tokens, emitter->cursor_i);
+		type      = jsmn_dom_get_type(   parser, tokens, num_tokens, emitter->cursor_i);
+
+		switch (emitter->cursor_phase) {
+			case PHASE_UNOPENED:
+				if (type == JSMN_OBJECT || type == JSMN_ARRAY) {
+					if (!(tokens[emitter->cursor_i].flags & JSMN_DOM_DIRTY) && value_len > 0) {
+						/* untouched since it was parsed: its original text, or what jsmn_emit() left of it */
+						jsmn_iov_put(&out, &js[start + emitter->cursor_pos], value_len - emitter->cursor_pos);
+						emitter->cursor_pos   = 0;
+						emitter->cursor_phase = PHASE_CLOSED;
+					} else {
+						jsmn_iov_punct(&out, type == JSMN_OBJECT ? "{" : "[", 1);
+						emitter->cursor_phase = PHASE_OPENED;
+					}
+				} else if (type == JSMN_STRING) {
+					jsmn_iov_string(&out, js, len, start, value_len);
+					if (jsmn_dom_get_type(parser, tokens, num_tokens, parent_i) == JSMN_OBJECT && child_i != -1) {
+						/* is a name of an object name-value pairing */
+						jsmn_iov_punct(&out, ": ", 2);
+						emitter->cursor_phase = PHASE_OPENED;
+					} else {
+						emitter->cursor_phase = PHASE_CLOSED;
+					}
+				} else if (type == JSMN_PRIMITIVE) {
+					jsmn_iov_put(&out, &js[start], value_len);
+					emitter->cursor_phase = PHASE_CLOSED;
+				} else {
+					return JSMN_ERROR_INVAL;
+				}
+				break;
+			case PHASE_OPENED:
+				if (child_i != -1) {
+					emitter->cursor_i = child_i;
+					emitter->cursor_phase = PHASE_UNOPENED;
+				} else {
+					emitter->cursor_phase = PHASE_UNCLOSED;
+				}
+				break;
+			case PHASE_UNCLOSED:
+				if (type == JSMN_OBJECT || type == JSMN_ARRAY) {
+					jsmn_iov_punct(&out, type == JSMN_OBJECT ? "}" : "]", 1);
+				}
+				emitter->cursor_phase = PHASE_CLOSED;
+				break;
+			case PHASE_CLOSED:
+				if (sibling_i != -1) {
+					jsmn_iov_punct(&out, ", ", 2);
+				}
+				emitter->cursor_i     = sibling_i != -1 ? sibling_i       : parent_i;
+				emitter->cursor_phase = sibling_i != -1 ? PHASE_UNOPENED : PHASE_UNCLOSED;
+				break;
+		}
+
+		if (out.full) {
+			*emitter = prior_emitter;
+			out.n    = prior_n;
+			out.used = prior_used;
+			if (out.n > 0) {
+				iov[out.n - 1].iov_len = prior_last_len;
+			}
+			break;
+		}
+	}
+
+	if (out.n == 0 && emitter->cursor_i != -1) {
+		return JSMN_ERROR_NOMEM;
+	}
+
+	return out.n;
+}
+#endif
+
+void jsmn_init_writer(jsmn_writer *writer, jsmn_sink sink, void *ctx, char *buf, size_t size, size_t flush_at) {
+	writer->sink     = sink;
+	writer->ctx      = ctx;
+	writer->buf      = buf;
+	writer->size     = size;
+	writer->flush_at = flush_at < size ? flush_at : size;
+	writer->head     = 0;
+	writer->tail     = 0;
+}
+jsmnint_t jsmn_writer_flush(jsmn_writer *writer) {
+	jsmnint_t rc;
+
+	while (writer->head < writer->tail) {
+		rc = writer->sink(writer->ctx, &writer->buf[writer->head], writer->tail - writer->head);
+		if (rc < 0) {
+			return rc;
+		}
+		if (rc == 0) {
+			return JSMN_ERROR_AGAIN;
+		}
+		writer->head += rc;
+	}
+
+	/* all taken: the whole block is free again */
+	writer->head = 0;
+	writer->tail = 0;
+
+	return 0;
+}
+/*
+ * Whether the emitter has closed the root, where jsmn_emit() stops without moving on.
+ */
+static int jsmn_emit_done(jsmn_parser *parser, jsmntok_t *tokens, jsmnuint_t num_tokens, jsmn_emitter *emitter) {
+	return emitter->cursor_i == -1 ||
+	       (emitter->cursor_phase == PHASE_CLOSED &&
+	        jsmn_dom_get_parent( parser, tokens, num_tokens, emitter->cursor_i) == -1 &&
+	        jsmn_dom_get_sibling(parser, tokens, num_tokens, emitter->cursor_i) == -1);
+}
+jsmnint_t jsmn_emit_to(jsmn_parser *parser, char *js, size_t len,
+		jsmntok_t *tokens, jsmnuint_t num_tokens,
+		jsmn_emitter *emitter, jsmn_writer *writer) {
+	jsmnint_t rc;
+
+	for (;;) {
+		if (writer->tail - writer->head >= writer->flush_at) {
+			rc = jsmn_writer_flush(writer);
+			if (rc < 0) {
+				return rc;
+			}
+		}
+		if (jsmn_emit_done(parser, tokens, num_tokens, emitter)) {
+			break;
+		}
+
+		rc = jsmn_emit(parser, js, len, tokens, num_tokens, emitter, &writer->buf[writer->tail], writer->size - writer->tail);
+		if (rc < 0) {
+			return rc;
+		}
+		writer->tail += rc;
+
+		if (rc == 0 && !jsmn_emit_done(parser, tokens, num_tokens, emitter)) {
+			/* the next token does not fit behind what is buffered */
+			if (writer->tail == 0) {
+				return JSMN_ERROR_NOMEM;
+			}
+			rc = jsmn_writer_flush(writer);
+			if (rc < 0) {
+				return rc;
+			}
+		}
+	}
+
+	return jsmn_writer_flush(writer);
+}
+
+#ifdef JSMN_EMIT_SINKS
+#include <errno.h>
+#include <stdlib.h> /* for realloc() */
+#include <unistd.h> /* for write() */
+
+jsmnint_t jsmn_sink_fd(void *ctx, const char *buf, size_t size) {
+	ssize_t rc;
+
+	for (;;) {
+		rc = write(*(int *) ctx, buf, size);
+		if (rc >= 0) {
+			return rc;
+		}
+		if (errno == EAGAIN || errno == EWOULDBLOCK) {
+			return 0;
+		}
+		if (errno != EINTR) {
+			return JSMN_ERROR_IO;
+		}
+	}
+}
+jsmnint_t jsmn_sink_mem(void *ctx, const char *buf, size_t size) {
+	jsmn_membuf *mem;
+	char *data;
+	size_t cap;
+
+	mem = (jsmn_membuf *) ctx;
+
+	if (mem->max != 0 && size > mem->max - mem->len) {
+		return JSMN_ERROR_NOMEM;
+	}
+
+	if (size > mem->cap - mem->len) {
+		cap = mem->cap > 0 ? mem->cap : 256;
+		while (size > cap - mem->len) {
+			cap *= 2;
+		}
+		if (mem->max != 0 && cap > mem->max) {
+			cap = mem->max;
+		}
+		data = (char *) realloc(mem->data, cap);
+		if (data == NULL) {
+			return JSMN_ERROR_NOMEM;
+		}
+		mem->data = data;
+		mem->cap  = cap;
+	}
+
+	our_memcpy(&mem->data[mem->len], buf, size);
+	mem->len += size;
+
+	return size;
+}
+#endif
 #endif
@@ -2,17 +2,49 @@
 #define __JSMN_H_
 
 #include <stddef.h>
+#if defined(JSMN_EMIT_IOV) || defined(JSMN_EMIT_SINKS)
+#ifndef JSMN_EMITTER
+#define JSMN_EMITTER
+#endif
+#endif
+#ifdef JSMN_EMIT_IOV
+#include <sys/uio.h> /* for struct iovec */
+#endif
 #ifdef JSMN_EMITTER
 #define JSMN_DOM
 #define JSMN_STRICT
 #endif
 #ifdef JSMN_DOM
 #endif
+#if defined(JSMN_COMPACT) && (defined(JSMN_DOM) || defined(JSMN_PARENT_LINKS))
+#error "JSMN_COMPACT tokens have no room for JSMN_DOM or JSMN_PARENT_LINKS links"
+#endif
+#if defined(JSMN_SKIP_LINKS) && (defined(JSMN_DOM) || defined(JSMN_COMPACT))
+#error "JSMN_SKIP_LINKS needs the flat default token layout"
+#endif
+#if defined(JSMN_THREADS) && defined(JSMN_DOM)
+#error "JSMN_THREADS needs the flat token layout"
+#endif
+#if defined(JSMN_COMPACT) && defined(JSMN_LARGE)
+#error "JSMN_COMPACT tokens have 32-bit offsets, JSMN_LARGE needs 64-bit ones"
+#endif
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+/**
+ * Offsets, token indices and counts. JSMN_LARGE widens them to pointer size,
+ * for documents and token arrays beyond 2 GiB.
+ */
+#ifdef JSMN_LARGE
+typedef ptrdiff_t    jsmnint_t;
+typedef size_t       jsmnuint_t;
+#else
+typedef int          jsmnint_t;
+typedef unsigned int jsmnuint_t;
+#endif
+
 /**
  * JSON type identifier. Basic types are:
  * 	o Object
@@ -34,54 +66,189 @@ enum jsmnerr {
 	/* Invalid character inside JSON string */
 	JSMN_ERROR_INVAL = -2,
 	/* The string is not a full JSON packet, more bytes expected */
-	JSMN_ERROR_PART = -3
+	JSMN_ERROR_PART = -3,
+	/* The number does not fit the type it was asked for */
+	JSMN_ERROR_RANGE = -4,
+	/* The sink would block, call again once it can take more */
+	JSMN_ERROR_AGAIN = -5,
+	/* The sink failed to write */
+	JSMN_ERROR_IO = -6,
+	/* A jsmn_parse_sax() callback stopped parsing */
+	JSMN_ERROR_STOPPED = -7
 };
 
 #ifdef JSMN_DOM
 struct children_t {
-	int first;
-	int last;
+	jsmnint_t first;
+	jsmnint_t last;
 };
 struct siblings_t {
-	int prev;
-	int next;
+	jsmnint_t prev;
+	jsmnint_t next;
 };
 struct family_t {
-	int parent;
+	jsmnint_t parent;
 	struct siblings_t siblings;
 	struct children_t children;
 };
+
+/**
+ * Hash index of the names of one object, over caller-provided slots: a name token
+ * index, -1 for an empty slot or -2 for a deleted one. Attached to the parser by
+ * jsmn_dom_index_object(), it serves jsmn_dom_get_utf8_name() for that object and
+ * is kept up to date by jsmn_dom_insert_name() and jsmn_dom_delete_name().
+ */
+typedef struct jsmn_dom_index {
+	jsmnint_t object_i;
+	const char *js;
+	size_t len;
+	jsmnint_t *slots;
+	jsmnuint_t num_slots; /* a power of two */
+	jsmnuint_t used;      /* slots that are not empty */
+	struct jsmn_dom_index *next;
+} jsmn_dom_index;
+
+/**
+ * Decoded values of one token, in a caller-provided array with an entry per token. Attached
+ * to the parser by jsmn_dom_cache_tokens(), it is filled in by the string length and number
+ * getters on their first call for a token, and cleared by jsmn_dom_set()/jsmn_dom_set_from().
+ */
+typedef struct {
+	size_t utf8len;
+	size_t utf32len;
+	double number;
+	long long int64;
+	unsigned long long uint64;
+	unsigned char known; /* JSMN_DOM_CACHE_* of the fields above that hold */
+} jsmn_dom_cache;
+
+#define JSMN_DOM_CACHE_UTF8LEN  1
+#define JSMN_DOM_CACHE_UTF32LEN 2
+#define JSMN_DOM_CACHE_DOUBLE   4
+#define JSMN_DOM_CACHE_INT64    8
+#define JSMN_DOM_CACHE_UINT64   16
 #endif
 
 
+/* String token flags. A flag that is not set is not known to hold */
+#define JSMN_STRING_NOESCAPE 1 /* no backslash escapes: the bytes are the value */
+#define JSMN_STRING_ASCII    2 /* only 7-bit bytes */
+
+/* Primitive token flags: the class of the primitive, 0 when the parser did not classify it */
+#define JSMN_PRIMITIVE_CLASS   7
+#define JSMN_PRIMITIVE_NULL    1
+#define JSMN_PRIMITIVE_TRUE    2
+#define JSMN_PRIMITIVE_FALSE   3
+#define JSMN_PRIMITIVE_INTEGER 4 /* fits int64, or uint64 when positive */
+#define JSMN_PRIMITIVE_FLOAT   5 /* any other number */
+
+/* Object and array token flag with JSMN_DOM: its text in js is no longer its value */
+#define JSMN_DOM_DIRTY 0x80 /* changed by the jsmn_dom_* calls since it was parsed, or never parsed */
+
+#ifdef JSMN_COMPACT
 /**
- * JSON token description.
+ * Compact JSON token description, 8 bytes.
+ * @param		start	start position in JSON data string
  * @param		type	type (object, array, string etc.)
+ * @param		flag	objects and arrays: still open; strings and primitives: has a value (key)
+ * @param		count	objects and arrays: number of children; strings and primitives: length
+ * Objects and arrays do not record their end. Use the JSMN_TOK_* accessors below.
+ */
+typedef struct jsmntok_s {
+	unsigned int start;
+	unsigned int type : 3;
+	unsigned int flag : 1;
+	unsigned int count : 28;
+} jsmntok_t;
+
+/* Longest string or primitive, and most children, a compact token can describe */
+#define JSMN_COMPACT_MAX 0x0fffffff
+
+#define JSMN_TOK_IS_CONTAINER(t) ((t)->type == JSMN_OBJECT || (t)->type == JSMN_ARRAY)
+#define JSMN_TOK_TYPE(t)  ((jsmntype_t) (t)->type)
+#define JSMN_TOK_START(t) ((int) (t)->start)
+#define JSMN_TOK_END(t)   (JSMN_TOK_IS_CONTAINER(t) ? -1 : (int) ((t)->start + (t)->count))
+#define JSMN_TOK_LEN(t)   (JSMN_TOK_IS_CONTAINER(t) ? 0 : (int) (t)->count)
+#define JSMN_TOK_SIZE(t)  (JSMN_TOK_IS_CONTAINER(t) ? (int) (t)->count : (int) (t)->flag)
+/* No room for string flags or primitive classes: nothing is known */
+#define JSMN_TOK_FLAGS(t) 0
+#else
+/**
+ * JSON token description.
+ * @param		type	type (object, array, string etc.), a jsmntype_t
+ * @param		flags	strings: JSMN_STRING_* facts the parser found while scanning;
+ *              		primitives: their JSMN_PRIMITIVE_* class
  * @param		start	start position in JSON data string
  * @param		end		end position in JSON data string
+ * @param		skip	with JSMN_SKIP_LINKS: index one past the token's last descendant,
+ *              		i.e. its next sibling; set for objects and arrays once closed
  */
 typedef struct jsmntok_s {
-	jsmntype_t type;
-	int start;
-	int end;
+	unsigned char type;
+	unsigned char flags;
+	jsmnint_t start;
+	jsmnint_t end;
 #ifdef JSMN_DOM
 	struct family_t family;
 #else
-	int size;
+	jsmnint_t size;
 #ifdef JSMN_PARENT_LINKS
-	int parent;
+	jsmnint_t parent;
+#endif
+#ifdef JSMN_SKIP_LINKS
+	jsmnint_t skip;
 #endif
 #endif
 } jsmntok_t;
 
+/* Token accessors, for callers that compile with and without JSMN_COMPACT */
+#define JSMN_TOK_TYPE(t)  ((jsmntype_t) (t)->type)
+#define JSMN_TOK_FLAGS(t) ((t)->flags)
+#define JSMN_TOK_START(t) ((t)->start)
+#define JSMN_TOK_END(t)   ((t)->end)
+#define JSMN_TOK_LEN(t)   ((t)->end - (t)->start)
+#ifndef JSMN_DOM
+#define JSMN_TOK_SIZE(t)  ((t)->size)
+#endif
+#endif /* !JSMN_COMPACT */
+
+#if !defined(JSMN_DOM) && !defined(JSMN_PARENT_LINKS)
+/* Open objects and arrays tracked by the parser without a backward token scan */
+#ifndef JSMN_STACK_SIZE
+#define JSMN_STACK_SIZE 32
+#endif
+#endif
+
+#ifdef JSMN_SAX
+/* Deepest nesting jsmn_parse_sax() accepts, one bit per level */
+#ifndef JSMN_SAX_DEPTH
+#define JSMN_SAX_DEPTH 256
+#endif
+#endif
+
 /**
  * JSON parser. Contains an array of token blocks available. Also stores
  * the string being parsed now and current position in that string
  */
 typedef struct {
-	unsigned int pos; /* offset in the JSON string */
-	unsigned int toknext; /* next token to allocate */
-	int toksuper; /* superior token node, e.g parent object or array */
+	jsmnuint_t pos; /* offset in the JSON string */
+	jsmnuint_t toknext; /* next token to allocate */
+	jsmnint_t toksuper; /* superior token node, e.g parent object or array */
+#if !defined(JSMN_DOM) && !defined(JSMN_PARENT_LINKS)
+	unsigned int depth; /* number of open objects and arrays */
+	jsmnint_t stack[JSMN_STACK_SIZE]; /* open objects and arrays, innermost last */
+#endif
+#ifdef JSMN_SAX
+	unsigned int sax_depth; /* number of open objects and arrays */
+	int sax_key; /* next value is a key */
+	int sax_stop; /* what the callback that stopped parsing returned */
+	unsigned char sax_objects[JSMN_SAX_DEPTH / 8]; /* open level is an object */
+#endif
+#ifdef JSMN_DOM
+	jsmn_dom_index *indexes; /* objects with a name index */
+	jsmn_dom_cache *cache;   /* decoded values by token index, or NULL */
+	jsmnuint_t num_cache;
+#endif
 } jsmn_parser;
 
 /**
@@ -92,64 +259,227 @@ void jsmn_init(jsmn_parser *parser);
 /**
  * Run JSON parser. It parses a JSON data string into and array of tokens, each describing
  * a single JSON object.
+ * When built with JSMN_SIMD, whitespace, string contents and primitives are skipped a
+ * vector (SSE2/AVX2) at a time; the tokens are the same.
+ * When built with JSMN_VALIDATE_UTF8, a string that is not well-formed UTF-8 (overlong,
+ * surrogate, above U+10FFFF or truncated sequences) is JSMN_ERROR_INVAL.
+ */
+jsmnint_t jsmn_parse(jsmn_parser *parser, const char *js, size_t len,
+		jsmntok_t *tokens, jsmnuint_t num_tokens);
+
+/**
+ * Token array allocator: resizes `ptr` to `size` bytes like realloc(), or returns NULL.
+ */
+typedef void *(*jsmn_realloc_t)(void *ctx, void *ptr, size_t size);
+
+/**
+ * Run JSON parser like jsmn_parse(), but instead of returning JSMN_ERROR_NOMEM, grow
+ * `*tokens` through `realloc_fn` and carry on from the token that did not fit.
+ * The array grows geometrically, up to `max_tokens` when it is not 0.
+ * `*tokens` may start out NULL. It is updated even when an error is returned.
+ */
+jsmnint_t jsmn_parse_ex(jsmn_parser *parser, const char *js, size_t len,
+		jsmntok_t **tokens, jsmnuint_t *num_tokens,
+		jsmn_realloc_t realloc_fn, void *ctx, jsmnuint_t max_tokens);
+
+/**
+ * Perfect hash of a fixed set of keys, for mapping object keys to field ids with one
+ * hash and one compare. Declare the keys once with an X-macro list, e.g.
+ *
+ *	#define USER_KEYS(X) X(id) X(name) X(admin)
+ *	enum { USER_KEYS(JSMN_KEY_ID) };           (JSMN_KEY_id = 0, JSMN_KEY_name, ...)
+ *	static const char *const user_keys[] = { USER_KEYS(JSMN_KEY_NAME) };
+ */
+#define JSMN_KEY_ID(key)   JSMN_KEY_##key,
+#define JSMN_KEY_NAME(key) #key,
+
+typedef struct {
+	const char *const *keys;
+	unsigned int num_keys;
+	unsigned long seed;
+	unsigned char *slots;   /* key index + 1, or 0 */
+	unsigned int num_slots; /* a power of two */
+} jsmn_keyset;
+
+/**
+ * Find a seed, starting from `seed`, under which the (at most 255) keys hash to distinct
+ * slots out of `num_slots`, a power of two. The search is quick with about 4 slots per
+ * key for a dozen keys, and needs more, up to the square of their number, for larger
+ * sets. Passing a seed found before makes setup a single pass.
+ * Returns 0, JSMN_ERROR_INVAL for bad arguments or duplicate keys, or JSMN_ERROR_NOMEM
+ * when no seed works.
+ */
+int jsmn_keyset_init(jsmn_keyset *keyset, const char *const *keys, unsigned int num_keys,
+		unsigned char *slots, unsigned int num_slots, unsigned long seed);
+
+/**
+ * Returns the index of the key `len` bytes at `key` in the set, or -1.
+ */
+int jsmn_keyset_match(const jsmn_keyset *keyset, const char *key, size_t len);
+
+/**
+ * Returns the index in the set of the key string token `tok`, or -1. Keys are matched on
+ * their raw bytes: a key spelled with escapes does not match.
  */
-int jsmn_parse(jsmn_parser *parser, const char *js, size_t len,
-		jsmntok_t *tokens, unsigned int num_tokens);
+int jsmn_keyset_token(const jsmn_keyset *keyset, const char *js, const jsmntok_t *tok);
+
+#ifdef JSMN_SIMD
+/**
+ * Count the tokens jsmn_parse() allocates for a JSON data string, without parsing it.
+ * The count is exact for well-formed JSON; malformed JSON is left for jsmn_parse() to report.
+ * When `depth` is not NULL, it is set to the deepest nesting of objects and arrays.
+ */
+jsmnint_t jsmn_count_tokens(const char *js, size_t len, unsigned int *depth);
+#endif
+
+#ifdef JSMN_SAX
+/**
+ * Callbacks of jsmn_parse_sax(), any of which may be NULL. Offsets are those tokens would
+ * have: `end` is one past the closing bracket, strings exclude their quotes.
+ * A non-zero return stops parsing.
+ */
+typedef struct {
+	int (*begin_object)(void *ctx, jsmnint_t start);
+	int (*end_object)(void *ctx, jsmnint_t end);
+	int (*begin_array)(void *ctx, jsmnint_t start);
+	int (*end_array)(void *ctx, jsmnint_t end);
+	int (*key)(void *ctx, jsmnint_t start, jsmnint_t end);
+	int (*string)(void *ctx, jsmnint_t start, jsmnint_t end);
+	int (*primitive)(void *ctx, jsmnint_t start, jsmnint_t end);
+} jsmn_sax;
+
+/**
+ * Run JSON parser without tokens, calling `sax` for every value as it is scanned.
+ * Returns the number of values seen so far, like jsmn_parse() does for tokens, or a
+ * JSMN_ERROR_*; JSMN_ERROR_PART leaves the parser ready for more data. When a callback
+ * stops parsing, JSMN_ERROR_STOPPED is returned with the callback's value in
+ * `parser->sax_stop`, and the next call resumes after that event.
+ * Memory use is the parser alone, whatever the document size.
+ */
+jsmnint_t jsmn_parse_sax(jsmn_parser *parser, const char *js, size_t len,
+		const jsmn_sax *sax, void *ctx);
+#endif
+
+#ifdef JSMN_THREADS
+/**
+ * Run JSON parser like jsmn_parse(), on `nthreads` threads (0: one per online CPU).
+ * The tokens and the parser state are the same as jsmn_parse() leaves them. Documents
+ * smaller than a few JSMN_THREADS_MIN_CHUNK bytes, a parser that already holds tokens,
+ * and anything the chunks cannot agree on are parsed by jsmn_parse() instead.
+ */
+jsmnint_t jsmn_parse_parallel(jsmn_parser *parser, const char *js, size_t len,
+		jsmntok_t *tokens, jsmnuint_t num_tokens, unsigned int nthreads);
+
+/**
+ * A record of a newline-delimited JSON batch: one non-blank line.
+ */
+typedef struct {
+	size_t start;    /* offset of the line */
+	size_t end;      /* offset of its '\n', or the end of the buffer */
+	size_t line;     /* line number, from 1 */
+	jsmnint_t first; /* first token of the record in the arena */
+	jsmnint_t count; /* number of tokens, or the JSMN_ERROR_* the line failed with */
+} jsmn_record;
+
+/**
+ * Parse a buffer of newline-delimited JSON (NDJSON / JSON Lines) on `nthreads` threads
+ * (0: one per online CPU). Every non-blank line is parsed on its own into
+ * tokens[first .. first + count). Token offsets are into `js`; parent and skip links are
+ * relative to the record's first token. A bad line, or one that does not fit in the
+ * arena, gets its error in `count` and the batch carries on.
+ * Returns the number of records, or JSMN_ERROR_NOMEM when there are more than
+ * `num_records`. With `records` NULL, only counts them. With `tokens` NULL, fills in the
+ * token counts and the arena layout without storing tokens.
+ */
+jsmnint_t jsmn_parse_ndjson(const char *js, size_t len, jsmntok_t *tokens, jsmnuint_t num_tokens,
+		jsmn_record *records, jsmnuint_t num_records, unsigned int nthreads);
+#endif
 
 #ifdef JSMN_DOM
-int        jsmn_dom_rollback(        jsmn_parser *parser,                             jsmntok_t *tokens, unsigned int num_tokens,               int i);
-int        jsmn_dom_is_null(         jsmn_parser *parser, const char *js, size_t len, jsmntok_t *tokens, unsigned int num_tokens,               int i);
-int        jsmn_dom_is_bool(         jsmn_parser *parser, const char *js, size_t len, jsmntok_t *tokens, unsigned int num_tokens,               int i);
-int        jsmn_dom_is_true(         jsmn_parser *parser, const char *js, size_t len, jsmntok_t *tokens, unsigned int num_tokens,               int i);
-int        jsmn_dom_is_false(        jsmn_parser *parser, const char *js, size_t len, jsmntok_t *tokens, unsigned int num_tokens,               int i);
-int        jsmn_dom_get_integer(     jsmn_parser *parser, const char *js, size_t len, jsmntok_t *tokens, unsigned int num_tokens,               int i, int     *value_ptr);
-int        jsmn_dom_get_double(      jsmn_parser *parser, const char *js, size_t len, jsmntok_t *tokens, unsigned int num_tokens,               int i, double  *value_ptr);
-int        jsmn_dom_get_utf8(        jsmn_parser *parser, const char *js, size_t len, jsmntok_t *tokens, unsigned int num_tokens,               int i, char    *val8,  size_t val8_len);
-size_t     jsmn_dom_get_utf8len(     jsmn_parser *parser, const char *js, size_t len, jsmntok_t *tokens, unsigned int num_tokens,               int i);
-int        jsmn_dom_get_utf32(       jsmn_parser *parser, const char *js, size_t len, jsmntok_t *tokens, unsigned int num_tokens,               int i, wchar_t *val32, size_t val32_len);
-size_t     jsmn_dom_get_utf32len(    jsmn_parser *parser, const char *js, size_t len, jsmntok_t *tokens, unsigned int num_tokens,               int i);
-int        jsmn_dom_get_value(       jsmn_parser *parser, const char *js, size_t len, jsmntok_t *tokens, unsigned int num_tokens,               int i, char    *buf,   size_t buflen);
-int        jsmn_dom_get_start(       jsmn_parser *parser,                             jsmntok_t *tokens, unsigned int num_tokens,               int i);
-size_t     jsmn_dom_get_strlen(      jsmn_parser *parser,                             jsmntok_t *tokens, unsigned int num_tokens,               int i);
-size_t     jsmn_dom_get_count(       jsmn_parser *parser,                             jsmntok_t *tokens, unsigned int num_tokens,               int i);
-jsmntype_t jsmn_dom_get_type(        jsmn_parser *parser,                             jsmntok_t *tokens, unsigned int num_tokens,               int i);
-
-int        jsmn_dom_get_parent(      jsmn_parser *parser,                             jsmntok_t *tokens, unsigned int num_tokens,               int i);
-int        jsmn_dom_get_child(       jsmn_parser *parser,                             jsmntok_t *tokens, unsigned int num_tokens,               int i);
-int        jsmn_dom_get_sibling(     jsmn_parser *parser,                             jsmntok_t *tokens, unsigned int num_tokens,               int i);
-int        jsmn_dom_is_open(         jsmn_parser *parser,                             jsmntok_t *tokens, unsigned int num_tokens,               int i);
-int        jsmn_dom_get_open(        jsmn_parser *parser,                             jsmntok_t *tokens, unsigned int num_tokens,               int i);
-
-int        jsmn_dom_add(             jsmn_parser *parser,                             jsmntok_t *tokens, unsigned int num_tokens, int parent_i, int i);
-int        jsmn_dom_delete(          jsmn_parser *parser,                             jsmntok_t *tokens, unsigned int num_tokens,               int i);
-int        jsmn_dom_move(            jsmn_parser *parser,                             jsmntok_t *tokens, unsigned int num_tokens, int parent_i, int i);
-int        jsmn_dom_replace(         jsmn_parser *parser,                             jsmntok_t *tokens, unsigned int num_tokens, int prior_i,  int i);
-
-int        jsmn_dom_set(             jsmn_parser *parser,                             jsmntok_t *tokens, unsigned int num_tokens,               int i, jsmntype_t type, int start, int end);
-int        jsmn_dom_set_from(        jsmn_parser *parser,                             jsmntok_t *tokens, unsigned int num_tokens, int to_i,     int i);
-int        jsmn_dom_close(           jsmn_parser *parser,                             jsmntok_t *tokens, unsigned int num_tokens,               int i,                             int end);
-
-int        jsmn_dom_new(             jsmn_parser *parser,                             jsmntok_t *tokens, unsigned int num_tokens);
-int        jsmn_dom_new_as(          jsmn_parser *parser,                             jsmntok_t *tokens, unsigned int num_tokens,                      jsmntype_t type, int start, int end);
-int        jsmn_dom_new_object(      jsmn_parser *parser,                             jsmntok_t *tokens, unsigned int num_tokens);
-int        jsmn_dom_new_array(       jsmn_parser *parser,                             jsmntok_t *tokens, unsigned int num_tokens);
-int        jsmn_dom_new_primitive(   jsmn_parser *parser,       char *js, size_t len, jsmntok_t *tokens, unsigned int num_tokens, const char *value);
-int        jsmn_dom_dup_primitive(   jsmn_parser *parser,                             jsmntok_t *tokens, unsigned int num_tokens,               int i);
-int        jsmn_dom_new_integer(     jsmn_parser *parser,       char *js, size_t len, jsmntok_t *tokens, unsigned int num_tokens, int         value);
-int        jsmn_dom_new_double(      jsmn_parser *parser,       char *js, size_t len, jsmntok_t *tokens, unsigned int num_tokens, double      value);
-int        jsmn_dom_new_string(      jsmn_parser *parser,       char *js, size_t len, jsmntok_t *tokens, unsigned int num_tokens, const char *value);
-int        jsmn_dom_new_utf8(        jsmn_parser *parser,       char *js, size_t len, jsmntok_t *tokens, unsigned int num_tokens, const char *value, size_t value_len);
+jsmnint_t  jsmn_dom_rollback(        jsmn_parser *parser,                             jsmntok_t *tokens, jsmnuint_t   num_tokens,                     jsmnint_t i);
+int        jsmn_dom_is_null(         jsmn_parser *parser, const char *js, size_t len, jsmntok_t *tokens, jsmnuint_t   num_tokens,                     jsmnint_t i);
+int        jsmn_dom_is_bool(         jsmn_parser *parser, const char *js, size_t len, jsmntok_t *tokens, jsmnuint_t   num_tokens,                     jsmnint_t i);
+int        jsmn_dom_is_true(         jsmn_parser *parser, const char *js, size_t len, jsmntok_t *tokens, jsmnuint_t   num_tokens,                     jsmnint_t i);
+int        jsmn_dom_is_false(        jsmn_parser *parser, const char *js, size_t len, jsmntok_t *tokens, jsmnuint_t   num_tokens,                     jsmnint_t i);
+int        jsmn_dom_get_integer(     jsmn_parser *parser, const char *js, size_t len, jsmntok_t *tokens, jsmnuint_t   num_tokens,                     jsmnint_t i, int     *value_ptr);
+int        jsmn_dom_get_double(      jsmn_parser *parser, const char *js, size_t len, jsmntok_t *tokens, jsmnuint_t   num_tokens,                     jsmnint_t i, double  *value_ptr);
+int        jsmn_dom_get_int64(       jsmn_parser *parser, const char *js, size_t len, jsmntok_t *tokens, jsmnuint_t   num_tokens,                     jsmnint_t i, long long *value_ptr);
+int        jsmn_dom_get_uint64(      jsmn_parser *parser, const char *js, size_t len, jsmntok_t *tokens, jsmnuint_t   num_tokens,                     jsmnint_t i, unsigned long long *value_ptr);
+/**
+ * Convert the numbers of array `array_i` into `values`. Returns how many were converted;
+ * when that stops short at a child that is not a number (not an integer in int64 range for
+ * jsmn_dom_get_int64s), `*stop_i` is that child, else -1. Returns JSMN_ERROR_NOMEM when
+ * the array has more than `num_values` children.
+ */
+jsmnint_t  jsmn_dom_get_doubles(     jsmn_parser *parser, const char *js, size_t len, jsmntok_t *tokens, jsmnuint_t   num_tokens, jsmnint_t array_i, double *values, size_t num_values, jsmnint_t *stop_i);
+jsmnint_t  jsmn_dom_get_int64s(      jsmn_parser *parser, const char *js, size_t len, jsmntok_t *tokens, jsmnuint_t   num_tokens, jsmnint_t array_i, long long *values, size_t num_values, jsmnint_t *stop_i);
+jsmnint_t  jsmn_dom_get_utf8(        jsmn_parser *parser, const char *js, size_t len, jsmntok_t *tokens, jsmnuint_t   num_tokens,                     jsmnint_t i, char    *val8,  size_t val8_len);
+size_t     jsmn_dom_get_utf8len(     jsmn_parser *parser, const char *js, size_t len, jsmntok_t *tokens, jsmnuint_t   num_tokens,                     jsmnint_t i);
+jsmnint_t  jsmn_dom_get_utf32(       jsmn_parser *parser, const char *js, size_t len, jsmntok_t *tokens, jsmnuint_t   num_tokens,                     jsmnint_t i, wchar_t *val32, size_t val32_len);
+size_t     jsmn_dom_get_utf32len(    jsmn_parser *parser, const char *js, size_t len, jsmntok_t *tokens, jsmnuint_t   num_tokens,                     jsmnint_t i);
+jsmnint_t  jsmn_dom_get_value(       jsmn_parser *parser, const char *js, size_t len, jsmntok_t *tokens, jsmnuint_t   num_tokens,                     jsmnint_t i, char    *buf,   size_t buflen);
+jsmnint_t  jsmn_dom_get_start(       jsmn_parser *parser,                             jsmntok_t *tokens, jsmnuint_t   num_tokens,                     jsmnint_t i);
+size_t     jsmn_dom_get_strlen(      jsmn_parser *parser,                             jsmntok_t *tokens, jsmnuint_t   num_tokens,                     jsmnint_t i);
+size_t     jsmn_dom_get_count(       jsmn_parser *parser,                             jsmntok_t *tokens, jsmnuint_t   num_tokens,                     jsmnint_t i);
+jsmntype_t jsmn_dom_get_type(        jsmn_parser *parser,                             jsmntok_t *tokens, jsmnuint_t   num_tokens,                     jsmnint_t i);
+
+jsmnint_t  jsmn_dom_get_parent(      jsmn_parser *parser,                             jsmntok_t *tokens, jsmnuint_t   num_tokens,                     jsmnint_t i);
+jsmnint_t  jsmn_dom_get_child(       jsmn_parser *parser,                             jsmntok_t *tokens, jsmnuint_t   num_tokens,                     jsmnint_t i);
+jsmnint_t  jsmn_dom_get_sibling(     jsmn_parser *parser,                             jsmntok_t *tokens, jsmnuint_t   num_tokens,                     jsmnint_t i);
+int        jsmn_dom_is_open(         jsmn_parser *parser,                             jsmntok_t *tokens, jsmnuint_t   num_tokens,                     jsmnint_t i);
+jsmnint_t  jsmn_dom_get_open(        jsmn_parser *parser,                             jsmntok_t *tokens, jsmnuint_t   num_tokens,                     jsmnint_t i);
+
+jsmnint_t  jsmn_dom_add(             jsmn_parser *parser,                             jsmntok_t *tokens, jsmnuint_t   num_tokens, jsmnint_t parent_i, jsmnint_t i);
+int        jsmn_dom_delete(          jsmn_parser *parser,                             jsmntok_t *tokens, jsmnuint_t   num_tokens,                     jsmnint_t i);
+int        jsmn_dom_move(            jsmn_parser *parser,                             jsmntok_t *tokens, jsmnuint_t   num_tokens, jsmnint_t parent_i, jsmnint_t i);
+int        jsmn_dom_replace(         jsmn_parser *parser,                             jsmntok_t *tokens, jsmnuint_t   num_tokens, jsmnint_t prior_i,  jsmnint_t i);
+
+int        jsmn_dom_set(             jsmn_parser *parser,                             jsmntok_t *tokens, jsmnuint_t   num_tokens,                     jsmnint_t i, jsmntype_t type, jsmnint_t start, jsmnint_t end);
+int        jsmn_dom_set_from(        jsmn_parser *parser,                             jsmntok_t *tokens, jsmnuint_t   num_tokens, jsmnint_t to_i,     jsmnint_t i);
+int        jsmn_dom_close(           jsmn_parser *parser,                             jsmntok_t *tokens, jsmnuint_t   num_tokens,                     jsmnint_t i,                                   jsmnint_t end);
+
+jsmnint_t  jsmn_dom_new(             jsmn_parser *parser,                             jsmntok_t *tokens, jsmnuint_t   num_tokens);
+jsmnint_t  jsmn_dom_new_as(          jsmn_parser *parser,                             jsmntok_t *tokens, jsmnuint_t   num_tokens,                            jsmntype_t type, jsmnint_t start, jsmnint_t end);
+jsmnint_t  jsmn_dom_new_object(      jsmn_parser *parser,                             jsmntok_t *tokens, jsmnuint_t   num_tokens);
+jsmnint_t  jsmn_dom_new_array(       jsmn_parser *parser,                             jsmntok_t *tokens, jsmnuint_t   num_tokens);
+jsmnint_t  jsmn_dom_new_primitive(   jsmn_parser *parser,       char *js, size_t len, jsmntok_t *tokens, jsmnuint_t   num_tokens, const char *value);
+jsmnint_t  jsmn_dom_dup_primitive(   jsmn_parser *parser,                             jsmntok_t *tokens, jsmnuint_t   num_tokens,                     jsmnint_t i);
+jsmnint_t  jsmn_dom_new_integer(     jsmn_parser *parser,       char *js, size_t len, jsmntok_t *tokens, jsmnuint_t   num_tokens, int         value);
+jsmnint_t  jsmn_dom_new_double(      jsmn_parser *parser,       char *js, size_t len, jsmntok_t *tokens, jsmnuint_t   num_tokens, double      value);
+jsmnint_t  jsmn_dom_new_int64(       jsmn_parser *parser,       char *js, size_t len, jsmntok_t *tokens, jsmnuint_t   num_tokens, long long   value);
+jsmnint_t  jsmn_dom_new_uint64(      jsmn_parser *parser,       char *js, size_t len, jsmntok_t *tokens, jsmnuint_t   num_tokens, unsigned long long value);
+jsmnint_t  jsmn_dom_new_string(      jsmn_parser *parser,       char *js, size_t len, jsmntok_t *tokens, jsmnuint_t   num_tokens, const char *value);
+jsmnint_t  jsmn_dom_new_utf8(        jsmn_parser *parser,       char *js, size_t len, jsmntok_t *tokens, jsmnuint_t   num_tokens, const char *value, size_t value_len);
 #define TRUE_EXPR  "true "
 #define FALSE_EXPR "false "
 #define NULL_EXPR  "null "
-int        jsmn_dom_eval(            jsmn_parser *parser,       char *js, size_t len, jsmntok_t *tokens, unsigned int num_tokens, const char *value);
+jsmnint_t  jsmn_dom_eval(            jsmn_parser *parser,       char *js, size_t len, jsmntok_t *tokens, jsmnuint_t   num_tokens, const char *value);
+
+jsmnint_t  jsmn_dom_get_utf8_name(   jsmn_parser *parser, const char *js, size_t len, jsmntok_t *tokens, jsmnuint_t   num_tokens, jsmnint_t object_i, char *utf8_name, size_t utf8_len);
+jsmnint_t  jsmn_dom_get_by_utf8_name(jsmn_parser *parser, const char *js, size_t len, jsmntok_t *tokens, jsmnuint_t   num_tokens, jsmnint_t object_i, char *utf8_name, size_t utf8_len);
+int        jsmn_dom_insert_name(     jsmn_parser *parser,                             jsmntok_t *tokens, jsmnuint_t   num_tokens, jsmnint_t object_i, jsmnint_t name_i, jsmnint_t value_i);
+int        jsmn_dom_insert_value(    jsmn_parser *parser,                             jsmntok_t *tokens, jsmnuint_t   num_tokens, jsmnint_t array_i,                    jsmnint_t value_i);
+int        jsmn_dom_delete_name(     jsmn_parser *parser,                             jsmntok_t *tokens, jsmnuint_t   num_tokens, jsmnint_t object_i, jsmnint_t name_i);
+int        jsmn_dom_delete_value(    jsmn_parser *parser,                             jsmntok_t *tokens, jsmnuint_t   num_tokens, jsmnint_t array_i,                    jsmnint_t value_i);
 
-int        jsmn_dom_get_utf8_name(   jsmn_parser *parser, const char *js, size_t len, jsmntok_t *tokens, unsigned int num_tokens, int object_i, char *utf8_name, size_t utf8_len);
-int        jsmn_dom_get_by_utf8_name(jsmn_parser *parser, const char *js, size_t len, jsmntok_t *tokens, unsigned int num_tokens, int object_i, char *utf8_name, size_t utf8_len);
-int        jsmn_dom_insert_name(     jsmn_parser *parser,                             jsmntok_t *tokens, unsigned int num_tokens, int object_i, int name_i, int value_i);
-int        jsmn_dom_insert_value(    jsmn_parser *parser,                             jsmntok_t *tokens, unsigned int num_tokens, int array_i,              int value_i);
-int        jsmn_dom_delete_name(     jsmn_parser *parser,                             jsmntok_t *tokens, unsigned int num_tokens, int object_i, int name_i);
-int        jsmn_dom_delete_value(    jsmn_parser *parser,                             jsmntok_t *tokens, unsigned int num_tokens, int array_i,              int value_i);
+/**
+ * Index the names of `object_i` into `num_slots` slots, a power of two of at least twice
+ * the number of names, and attach the index to the parser. Returns JSMN_ERROR_NOMEM when
+ * the slots are too few. An insertion that would fill more than half of the slots detaches
+ * the index again, and lookups go back to a linear scan until it is rebuilt larger.
+ * Names added or removed other than by jsmn_dom_insert_name()/jsmn_dom_delete_name()
+ * require jsmn_dom_unindex_object() first.
+ */
+int        jsmn_dom_index_object(    jsmn_parser *parser, const char *js, size_t len, jsmntok_t *tokens, jsmnuint_t   num_tokens, jsmnint_t object_i, jsmn_dom_index *index, jsmnint_t *slots, jsmnuint_t num_slots);
+void       jsmn_dom_unindex_object(  jsmn_parser *parser,                                                                                     jsmn_dom_index *index);
+
+/**
+ * Attach `num_cache` cache entries to the parser, for tokens 0 to `num_cache` - 1, or detach
+ * the cache with NULL. The entries start out empty. Tokens changed other than through
+ * jsmn_dom_set()/jsmn_dom_set_from() and the parser, or a JSON string edited in place,
+ * require attaching the cache again.
+ */
+void       jsmn_dom_cache_tokens(    jsmn_parser *parser,                                                                                     jsmn_dom_cache *cache, jsmnuint_t num_cache);
 #endif
 
 #ifdef JSMN_EMITTER
@@ -160,11 +490,12 @@ enum tokphase {
 	PHASE_CLOSED
 };
 typedef struct {
-	int           cursor_i;
+	jsmnint_t     cursor_i;
 	enum tokphase cursor_phase;
+	size_t        cursor_pos; /* bytes of an unchanged object or array copied so far */
 } jsmn_emitter;
 
-void jsmn_emit_seek(   jsmn_emitter *emitter, int object_i);
+void jsmn_emit_seek(   jsmn_emitter *emitter, jsmnint_t object_i);
 
 void jsmn_init_emitter(jsmn_emitter *emitter);
 
@@ -177,11 +508,91 @@ void jsmn_init_emitter(jsmn_emitter *emitter);
  * Returns JSMN_ERROR_* when < 0;
  *
  * When emission is complete: `emitter->cursor_i == -1`.
- * Emission starts at emitter state, which defaults to `{0, PHASE_UNOPENED}`.
+ * Emission starts at emitter state, which defaults to `{0, PHASE_UNOPENED, 0}`.
  */
-int jsmn_emit(jsmn_parser *parser, char *js, size_t len,
-		jsmntok_t *tokens, unsigned int num_tokens,
+jsmnint_t jsmn_emit(jsmn_parser *parser, char *js, size_t len,
+		jsmntok_t *tokens, jsmnuint_t num_tokens,
 		jsmn_emitter *emitter, char *outjs, size_t outlen);
+
+#ifdef JSMN_EMIT_IOV
+/*
+ * Emit as many remaining tokens as possible as up to `iovcnt` entries of `iov`, ready for writev().
+ * Strings, primitives and unchanged objects and arrays point straight into `js`; only punctuation
+ * is written, into `scratch` of length `scratch_len`, so `js` and `scratch` must outlive the write.
+ * Call iteratively, writing out each batch before the next reuses `scratch`. Three entries and
+ * four bytes of scratch always leave room for the next token: the worst is an object name whose
+ * quotes are not around it in `js`, which takes its opening quote, itself, and its closing quote
+ * with the `: ` that follows.
+ *
+ * Returns the number of entries filled in `iov` when >= 0:
+ * Returns JSMN_ERROR_NOMEM when not even the next token fits, JSMN_ERROR_* when < 0;
+ *
+ * When emission is complete: `emitter->cursor_i == -1`.
+ */
+int jsmn_emit_iov(jsmn_parser *parser, const char *js, size_t len,
+		jsmntok_t *tokens, jsmnuint_t num_tokens,
+		jsmn_emitter *emitter, struct iovec *iov, int iovcnt, char *scratch, size_t scratch_len);
+#endif
+
+/*
+ * A sink takes up to `size` bytes of `buf` and returns how many it took, 0 when it would block,
+ * or JSMN_ERROR_* when < 0.
+ */
+typedef jsmnint_t (*jsmn_sink)(void *ctx, const char *buf, size_t size);
+
+/*
+ * Buffers emitted text in the block `buf` of length `size` on its way to a sink. Text is handed
+ * to the sink once `flush_at` bytes are waiting, or when the block is full.
+ */
+typedef struct {
+	jsmn_sink  sink;
+	void      *ctx;
+	char      *buf;
+	size_t     size;
+	size_t     flush_at;
+	size_t     head; /* first byte the sink has not taken */
+	size_t     tail; /* one past the last byte emitted */
+} jsmn_writer;
+
+void jsmn_init_writer(jsmn_writer *writer, jsmn_sink sink, void *ctx, char *buf, size_t size, size_t flush_at);
+
+/*
+ * Hands all buffered text to the sink.
+ *
+ * Returns 0 once the sink took all of it, JSMN_ERROR_AGAIN when it would block, JSMN_ERROR_* when < 0.
+ */
+jsmnint_t jsmn_writer_flush(jsmn_writer *writer);
+
+/*
+ * Emit the remaining tokens through `writer`, in constant memory. After JSMN_ERROR_AGAIN, call
+ * again with the same emitter and writer once the sink can take more; nothing is lost or repeated.
+ *
+ * Returns 0 when emission is complete and the sink took all of it:
+ * Returns JSMN_ERROR_NOMEM when a token does not fit in an empty block, JSMN_ERROR_* when < 0;
+ */
+jsmnint_t jsmn_emit_to(jsmn_parser *parser, char *js, size_t len,
+		jsmntok_t *tokens, jsmnuint_t num_tokens,
+		jsmn_emitter *emitter, jsmn_writer *writer);
+
+#ifdef JSMN_EMIT_SINKS
+/*
+ * Writes to the file descriptor `*(int *) ctx`, which may be non-blocking.
+ */
+jsmnint_t jsmn_sink_fd(void *ctx, const char *buf, size_t size);
+
+/*
+ * Appends to the growable `jsmn_membuf` at `ctx`, allocated with realloc() and freed by the
+ * caller; `data` is not null-terminated. Set `max` to cap its length, 0 for no cap.
+ */
+typedef struct {
+	char   *data;
+	size_t  len;
+	size_t  cap;
+	size_t  max;
+} jsmn_membuf;
+
+jsmnint_t jsmn_sink_mem(void *ctx, const char *buf, size_t size);
+#endif
 #endif
 
 #ifdef __cplusplus
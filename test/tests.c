@@ -2,6 +2,15 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdarg.h>
+#ifdef JSMN_LARGE
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+#ifdef JSMN_EMIT_SINKS
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
 #include "test.h"
 #include "testutil.h"
@@ -227,6 +236,60 @@ int test_array_nomem(void) {
 	return 0;
 }
 
+static void *test_realloc(void *ctx, void *ptr, size_t size) {
+	(*(int *) ctx)++;
+	return realloc(ptr, size);
+}
+
+int test_parse_ex(void) {
+	int r;
+	int i;
+	int reallocs;
+	jsmn_parser p;
+	jsmntok_t *tok;
+	jsmnuint_t tokcount;
+	char js[1024];
+
+	strcpy(js, "[");
+	for (i = 0; i < 100; i++) {
+		strcat(js, i == 0 ? "{\"a\": 1}" : ", {\"a\": 1}");
+	}
+	strcat(js, "]");
+
+	tok = NULL;
+	tokcount = 0;
+	reallocs = 0;
+	jsmn_init(&p);
+	r = jsmn_parse_ex(&p, js, strlen(js), &tok, &tokcount, test_realloc, &reallocs, 0);
+	check(r == 301);
+	check(p.toknext == 301);
+	check(tokcount >= 301 && tokcount < 2 * 301);
+	check(reallocs == 6);
+#ifndef JSMN_DOM
+	check(JSMN_TOK_SIZE(&tok[0]) == 100);
+#endif
+	check(tokeq(js, tok, 4,
+				JSMN_ARRAY, 0, (int) strlen(js), -1,
+				JSMN_OBJECT, 1, 9, 1,
+				JSMN_STRING, "a", 1,
+				JSMN_PRIMITIVE, "1"));
+	check(tokeq(js, tok + 298, 3,
+				JSMN_OBJECT, (int) strlen(js) - 9, (int) strlen(js) - 1, 1,
+				JSMN_STRING, "a", 1,
+				JSMN_PRIMITIVE, "1"));
+	free(tok);
+
+	tok = NULL;
+	reallocs = 0;
+	jsmn_init(&p);
+	r = jsmn_parse_ex(&p, js, strlen(js), &tok, &tokcount, test_realloc, &reallocs, 100);
+	check(r == JSMN_ERROR_NOMEM);
+	check(tokcount == 100);
+	check(p.toknext == 100);
+	free(tok);
+	return 0;
+}
+
 int test_unquoted_keys(void) {
 #ifndef JSMN_STRICT
 	int r;
@@ -341,6 +404,1374 @@ int test_count(void) {
 }
 
 
+int test_long_runs(void) {
+#ifdef JSMN_STRICT
+	int i;
+	int r;
+	jsmn_parser p;
+	jsmntok_t tok[5];
+#endif
+	const char *js;
+
+	js = "{\"a\":                                        "
+		"\"0123456789abcdef0123456789abcdef0123456789abcdef\\\"0123456789abcdef\\u00e9\",\n"
+		"\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t"
+		"\"b\" : 12345678901234567890123456789012345678901234567890.5e+10            }";
+
+	check(parse(js, 5, 5,
+				JSMN_OBJECT, -1, -1, 2,
+				JSMN_STRING, "a", 1,
+				JSMN_STRING, "0123456789abcdef0123456789abcdef0123456789abcdef\\\"0123456789abcdef\\u00e9", 0,
+				JSMN_STRING, "b", 1,
+				JSMN_PRIMITIVE, "12345678901234567890123456789012345678901234567890.5e+10"));
+
+#ifdef JSMN_STRICT
+	/* In non-strict mode a truncated primitive is a complete one */
+	jsmn_init(&p);
+	for (i = 1; i <= strlen(js); i++) {
+		r = jsmn_parse(&p, js, i, tok, sizeof(tok)/sizeof(tok[0]));
+		if (i == strlen(js)) {
+			check(r == 5);
+		} else {
+			check(r == JSMN_ERROR_PART);
+		}
+	}
+#endif
+
+	check(parse("[\"0123456789abcdef0123456789abcdef0123456789abcdef\x01\", "
+				"0123456789abcdef0123456789abcdef0123456789abcdef]", 3, 3,
+				JSMN_ARRAY, -1, -1, 2,
+				JSMN_STRING, "0123456789abcdef0123456789abcdef0123456789abcdef\x01", 0,
+				JSMN_PRIMITIVE, "0123456789abcdef0123456789abcdef0123456789abcdef"));
+	check(parse("[0123456789abcdef0123456789abcdef0123456789abcdef\x01]", JSMN_ERROR_INVAL, 2));
+	check(parse("[0123456789abcdef0123456789abcdef0123456789abcdef\xC3\xA9]", JSMN_ERROR_INVAL, 2));
+	return 0;
+}
+
+int test_deep_nesting(void) {
+	int i;
+	int r;
+	int pos;
+	jsmn_parser p;
+	jsmntok_t tok[128];
+	char js[256];
+
+	/* [[[...[1], 2]..., 2] nested deeper than the parser tracks directly */
+	pos = 0;
+	for (i = 0; i < 48; i++) {
+		js[pos++] = '[';
+	}
+	js[pos++] = '1';
+	for (i = 0; i < 48; i++) {
+		js[pos++] = ']';
+		if (i < 47) {
+			js[pos++] = ',';
+			js[pos++] = '2';
+		}
+	}
+	js[pos] = '\0';
+
+	jsmn_init(&p);
+	r = jsmn_parse(&p, js, strlen(js), tok, 128);
+	check(r == 48 + 1 + 47);
+	for (i = 0; i < 48; i++) {
+		check(tok[i].type == JSMN_ARRAY);
+		check(JSMN_TOK_START(&tok[i]) == i);
+#ifndef JSMN_COMPACT
+		check(tok[i].end == (int) strlen(js) - 3 * i);
+#endif
+#ifndef JSMN_DOM
+		check(JSMN_TOK_SIZE(&tok[i]) == (i == 47 ? 1 : 2));
+#endif
+	}
+	for (; i < r; i++) {
+		check(tok[i].type == JSMN_PRIMITIVE);
+		check(js[JSMN_TOK_START(&tok[i])] == (i == 48 ? '1' : '2'));
+	}
+
+	js[strlen(js) - 1] = '}';
+	jsmn_init(&p);
+	check(jsmn_parse(&p, js, strlen(js), tok, 128) == JSMN_ERROR_INVAL);
+
+	js[strlen(js) - 1] = '\0';
+	jsmn_init(&p);
+	check(jsmn_parse(&p, js, strlen(js), tok, 128) == JSMN_ERROR_PART);
+
+	check(parse("{\"a\": [1, 2, {\"b\": [3]}, 4], \"c\": 5}", 12, 12,
+				JSMN_OBJECT, 0, 36, 2,
+				JSMN_STRING, "a", 1,
+				JSMN_ARRAY, 6, 27, 4,
+				JSMN_PRIMITIVE, "1",
+				JSMN_PRIMITIVE, "2",
+				JSMN_OBJECT, 13, 23, 1,
+				JSMN_STRING, "b", 1,
+				JSMN_ARRAY, 19, 22, 1,
+				JSMN_PRIMITIVE, "3",
+				JSMN_PRIMITIVE, "4",
+				JSMN_STRING, "c", 1,
+				JSMN_PRIMITIVE, "5"));
+	return 0;
+}
+
+#ifdef JSMN_COMPACT
+int test_compact(void) {
+	jsmn_parser p;
+	jsmntok_t tok[16];
+	const char *js = "{\"a\": [1, \"xyz\"], \"b\": {}, \"c\"";
+	int r;
+
+	check(sizeof(jsmntok_t) == 8);
+
+	jsmn_init(&p);
+	r = jsmn_parse(&p, js, strlen(js), tok, 16);
+	check(r == JSMN_ERROR_PART);
+	check(p.toknext == 8);
+	check(JSMN_TOK_TYPE(&tok[0]) == JSMN_OBJECT);
+	check(JSMN_TOK_SIZE(&tok[0]) == 3);
+	check(JSMN_TOK_END(&tok[0]) == -1);
+	check(JSMN_TOK_SIZE(&tok[1]) == 1);
+	check(JSMN_TOK_START(&tok[2]) == 6);
+	check(JSMN_TOK_SIZE(&tok[2]) == 2);
+	check(JSMN_TOK_START(&tok[4]) == 11 && JSMN_TOK_END(&tok[4]) == 14);
+	check(JSMN_TOK_LEN(&tok[4]) == 3 && JSMN_TOK_SIZE(&tok[4]) == 0);
+	check(JSMN_TOK_SIZE(&tok[6]) == 0);
+	check(JSMN_TOK_SIZE(&tok[7]) == 0);
+
+	return 0;
+}
+#endif
+
+#ifdef JSMN_SKIP_LINKS
+int test_skip_links(void) {
+	jsmn_parser p;
+	jsmntok_t tok[16];
+	const char *js = "{\"a\": [1, {\"b\": 2}, []], \"c\": \"d\", \"e\": {}}";
+	int r, i, n;
+
+	jsmn_init(&p);
+	r = jsmn_parse(&p, js, strlen(js), tok, 16);
+	check(r == 12);
+	check(tok[0].skip == 12);
+	check(tok[1].skip == 8 && tok[2].skip == 8);
+	check(tok[3].skip == 4);
+	check(tok[4].skip == 7 && tok[5].skip == 7 && tok[6].skip == 7);
+	check(tok[7].skip == 8);
+	check(tok[8].skip == 10 && tok[9].skip == 10);
+	check(tok[10].skip == 12 && tok[11].skip == 12);
+
+	/* Walk the root object's keys without visiting their values */
+	n = 0;
+	for (i = 1; i < tok[0].skip; i = tok[i].skip) {
+		check(tok[i].type == JSMN_STRING && tok[i].size == 1);
+		n++;
+	}
+	check(n == tok[0].size);
+
+	/* Walk the elements of "a" */
+	n = 0;
+	for (i = 3; i < tok[2].skip; i = tok[i].skip) {
+		n++;
+	}
+	check(n == tok[2].size);
+
+#ifndef JSMN_STRICT
+	/* Unquoted keys skip their values too */
+	js = "{a: 1, b: [2,3], c: x}";
+	jsmn_init(&p);
+	r = jsmn_parse(&p, js, strlen(js), tok, 16);
+	check(r == 9);
+	check(tok[0].skip == 9);
+	check(tok[1].skip == 3 && tok[2].skip == 3);
+	check(tok[3].skip == 7 && tok[4].skip == 7);
+	check(tok[7].skip == 9 && tok[8].skip == 9);
+	n = 0;
+	for (i = 1; i < tok[0].skip; i = tok[i].skip) {
+		check(tok[i].type == JSMN_PRIMITIVE && tok[i].size == 1);
+		n++;
+	}
+	check(n == tok[0].size);
+#endif
+
+	return 0;
+}
+#endif
+
+#define USER_KEYS(X) X(id) X(name) X(admin) X(uid) X(groups) X(email) X(created) X(updated) \
+	X(tags) X(score) X(active) X(owner)
+enum { USER_KEYS(JSMN_KEY_ID) JSMN_KEY_COUNT };
+static const char *const user_keys[] = { USER_KEYS(JSMN_KEY_NAME) };
+
+int test_keyset(void) {
+	const char *js = "{\"name\": \"x\", \"nam\": 1, \"names\": 2, \"owner\": 3, \"id\": 4, \"n\\u0061me\": 5, \"other\": 6}";
+	static const int ids[] = {JSMN_KEY_name, -1, -1, JSMN_KEY_owner, JSMN_KEY_id, -1, -1};
+	const char *const dup[] = {"a", "b", "a"};
+	unsigned char slots[64];
+	unsigned char slots2[64];
+	jsmn_keyset ks;
+	jsmn_keyset ks2;
+	jsmn_parser p;
+	jsmntok_t t[16];
+	int i;
+
+	check(JSMN_KEY_COUNT == 12 && JSMN_KEY_owner == 11);
+	check(jsmn_keyset_init(&ks, user_keys, JSMN_KEY_COUNT, slots, 48, 0) == JSMN_ERROR_INVAL);
+	check(jsmn_keyset_init(&ks, dup, 3, slots, 64, 0) == JSMN_ERROR_INVAL);
+	check(jsmn_keyset_init(&ks, user_keys, JSMN_KEY_COUNT, slots, 64, 0) == 0);
+
+	for (i = 0; i < JSMN_KEY_COUNT; i++) {
+		check(jsmn_keyset_match(&ks, user_keys[i], strlen(user_keys[i])) == i);
+	}
+	check(jsmn_keyset_match(&ks, "", 0) == -1);
+	check(jsmn_keyset_match(&ks, "idx", 3) == -1);
+	check(jsmn_keyset_match(&ks, "i", 1) == -1);
+
+	jsmn_init(&p);
+	check(jsmn_parse(&p, js, strlen(js), t, 16) == 15);
+	for (i = 0; i < 7; i++) {
+		check(jsmn_keyset_token(&ks, js, &t[1 + 2 * i]) == ids[i]);
+	}
+	check(jsmn_keyset_token(&ks, js, &t[4]) == -1);
+
+	/* A known seed is taken as it is */
+	check(jsmn_keyset_init(&ks2, user_keys, JSMN_KEY_COUNT, slots2, 64, ks.seed) == 0);
+	check(ks2.seed == ks.seed && memcmp(slots, slots2, 64) == 0);
+	return 0;
+}
+
+#ifndef JSMN_COMPACT
+int test_string_flags(void) {
+	const char *js = "[\"abc\", \"a\\nb\", \"caf\xc3\xa9\", \"\", "
+		"\"0123456789012345678901234567890123456789\", \"0123456789012345678901234567890123456789\xc3\xa9\", "
+		"\"0123456789012345678901234567890123456789\\u00e9\", 1]";
+	jsmn_parser p;
+	jsmntok_t t[16];
+#ifdef JSMN_DOM
+	char buf[64];
+#endif
+
+	jsmn_init(&p);
+	check(jsmn_parse(&p, js, strlen(js), t, 16) == 9);
+	check(JSMN_TOK_FLAGS(&t[1]) == (JSMN_STRING_NOESCAPE | JSMN_STRING_ASCII));
+	check(JSMN_TOK_FLAGS(&t[2]) == JSMN_STRING_ASCII);
+	check(JSMN_TOK_FLAGS(&t[3]) == JSMN_STRING_NOESCAPE);
+	check(JSMN_TOK_FLAGS(&t[4]) == (JSMN_STRING_NOESCAPE | JSMN_STRING_ASCII));
+	check(JSMN_TOK_FLAGS(&t[5]) == (JSMN_STRING_NOESCAPE | JSMN_STRING_ASCII));
+	check(JSMN_TOK_FLAGS(&t[6]) == JSMN_STRING_NOESCAPE);
+	check(JSMN_TOK_FLAGS(&t[7]) == JSMN_STRING_ASCII);
+	check(JSMN_TOK_FLAGS(&t[8]) == JSMN_PRIMITIVE_INTEGER);
+
+#ifdef JSMN_DOM
+	/* Plain strings are copied as they are, others unquoted */
+	check(jsmn_dom_get_utf8(&p, js, strlen(js), t, 16, 1, buf, sizeof(buf)) == 3 && strcmp(buf, "abc") == 0);
+	check(jsmn_dom_get_utf8(&p, js, strlen(js), t, 16, 1, buf, 3) == 2 && strcmp(buf, "ab") == 0);
+	check(jsmn_dom_get_utf8(&p, js, strlen(js), t, 16, 2, buf, sizeof(buf)) == 3 && strcmp(buf, "a\nb") == 0);
+	check(jsmn_dom_get_utf8len(&p, js, strlen(js), t, 16, 5) == 40);
+	check(jsmn_dom_get_utf8len(&p, js, strlen(js), t, 16, 7) == 42);
+#endif
+	return 0;
+}
+int test_primitive_class(void) {
+	const char *js = "[null, true, false, 0, -12, 1.5, 1e3, -0.0, 9999999999999999999, "
+		"18446744073709551615, 18446744073709551616, -9223372036854775808, -9223372036854775809, \"null\"]";
+	static const unsigned char classes[] = {
+		JSMN_PRIMITIVE_NULL, JSMN_PRIMITIVE_TRUE, JSMN_PRIMITIVE_FALSE,
+		JSMN_PRIMITIVE_INTEGER, JSMN_PRIMITIVE_INTEGER, JSMN_PRIMITIVE_FLOAT, JSMN_PRIMITIVE_FLOAT,
+		JSMN_PRIMITIVE_FLOAT, JSMN_PRIMITIVE_INTEGER, JSMN_PRIMITIVE_INTEGER, JSMN_PRIMITIVE_FLOAT,
+		JSMN_PRIMITIVE_INTEGER, JSMN_PRIMITIVE_FLOAT, JSMN_STRING_NOESCAPE | JSMN_STRING_ASCII
+	};
+	jsmn_parser p;
+	jsmntok_t t[16];
+	int i;
+#ifdef JSMN_DOM
+	double value;
+#endif
+
+	jsmn_init(&p);
+	check(jsmn_parse(&p, js, strlen(js), t, 16) == 15);
+	for (i = 0; i < 14; i++) {
+		check(JSMN_TOK_FLAGS(&t[i + 1]) == classes[i]);
+	}
+
+#ifndef JSMN_STRICT
+	/* Bare words and malformed numbers are left unclassified */
+	js = "[nul, abc, -, 1., .5, 1e, 01x]";
+	jsmn_init(&p);
+	check(jsmn_parse(&p, js, strlen(js), t, 16) == 8);
+	for (i = 1; i < 8; i++) {
+		check(JSMN_TOK_FLAGS(&t[i]) == 0);
+	}
+#endif
+
+#ifdef JSMN_DOM
+	/* Queries answer from the class, and from the text once it is gone */
+	js = "[null, true, false, 7]";
+	jsmn_init(&p);
+	check(jsmn_parse(&p, js, strlen(js), t, 16) == 5);
+	check(jsmn_dom_is_null(&p, js, strlen(js), t, 16, 1) && !jsmn_dom_is_null(&p, js, strlen(js), t, 16, 4));
+	check(jsmn_dom_is_true(&p, js, strlen(js), t, 16, 2) && !jsmn_dom_is_true(&p, js, strlen(js), t, 16, 3));
+	check(jsmn_dom_is_false(&p, js, strlen(js), t, 16, 3) && jsmn_dom_is_bool(&p, js, strlen(js), t, 16, 2));
+	check(!jsmn_dom_is_bool(&p, js, strlen(js), t, 16, 4));
+	check(jsmn_dom_get_double(&p, js, strlen(js), t, 16, 1, &value) == JSMN_ERROR_INVAL);
+	check(jsmn_dom_set(&p, t, 16, 4, JSMN_PRIMITIVE, 1, 5) == 0);
+	check(JSMN_TOK_FLAGS(&t[4]) == 0 && jsmn_dom_is_null(&p, js, strlen(js), t, 16, 4));
+	check(jsmn_dom_set_from(&p, t, 16, 4, 2) == 0);
+	check(JSMN_TOK_FLAGS(&t[4]) == JSMN_PRIMITIVE_TRUE && jsmn_dom_is_true(&p, js, strlen(js), t, 16, 4));
+#endif
+	return 0;
+}
+int test_container_flags(void) {
+#ifdef JSMN_STRICT
+	const char *js = "{\"a\": 1, \"b\": [2,3], \"c\": \"x\"}";
+#else
+	const char *js = "{a: 1, b: [2,3], c: x}";
+#endif
+	jsmn_parser p;
+	jsmntok_t t[16];
+
+	/* Whatever was in the caller's array does not show through */
+	memset(t, 0xAB, sizeof(t));
+	jsmn_init(&p);
+	check(jsmn_parse(&p, js, strlen(js), t, 16) == 9);
+	check(t[0].type == JSMN_OBJECT && JSMN_TOK_FLAGS(&t[0]) == 0);
+	check(t[4].type == JSMN_ARRAY  && JSMN_TOK_FLAGS(&t[4]) == 0);
+	return 0;
+}
+#endif
+
+#ifdef JSMN_DOM
+int test_dom_index(void) {
+	static char js[16384];
+	static jsmntok_t tokens[2048];
+	static jsmnint_t slots[1024], big[2048];
+	jsmnint_t small[4];
+	jsmn_dom_index index, index2;
+	jsmn_parser p;
+	char name[16];
+	jsmnint_t name_i, value_i;
+	size_t pos;
+	int i, r, n = 300;
+
+	pos = sprintf(js, "{\"a\\u0062\": 0, \"dup\": 1, \"dup\": 2");
+	for (i = 0; i < n; i++) {
+		pos += sprintf(js + pos, ", \"k%d\": %d", i, i);
+	}
+	strcpy(js + pos, "}");
+	jsmn_init(&p);
+	r = jsmn_parse(&p, js, strlen(js), tokens, 2048);
+	check(r == 2 * (n + 3) + 1);
+
+	check(jsmn_dom_index_object(&p, js, sizeof(js), tokens, 2048, 0, &index, small, 4) == JSMN_ERROR_NOMEM);
+	check(jsmn_dom_index_object(&p, js, sizeof(js), tokens, 2048, 0, &index, slots, 1000) == JSMN_ERROR_INVAL);
+	check(jsmn_dom_index_object(&p, js, sizeof(js), tokens, 2048, 0, &index, slots, 1024) == 0);
+
+	/* Escaped and duplicate names */
+	check(jsmn_dom_get_utf8_name(&p, js, sizeof(js), tokens, 2048, 0, "ab", 2) == 1);
+	check(jsmn_dom_get_utf8_name(&p, js, sizeof(js), tokens, 2048, 0, "dup", 3) == 3);
+	check(jsmn_dom_get_utf8_name(&p, js, sizeof(js), tokens, 2048, 0, "a\\u0062", 7) == -1);
+	for (i = 0; i < n; i++) {
+		sprintf(name, "k%d", i);
+		name_i = jsmn_dom_get_utf8_name(&p, js, sizeof(js), tokens, 2048, 0, name, strlen(name));
+		check(name_i == 7 + 2 * i);
+		value_i = jsmn_dom_get_by_utf8_name(&p, js, sizeof(js), tokens, 2048, 0, name, strlen(name));
+		check(value_i == name_i + 1);
+	}
+	check(jsmn_dom_get_utf8_name(&p, js, sizeof(js), tokens, 2048, 0, "k300", 4) == -1);
+
+	/* Kept up to date */
+	check(jsmn_dom_delete_name(&p, tokens, 2048, 0, 3) == 0);
+	check(jsmn_dom_get_utf8_name(&p, js, sizeof(js), tokens, 2048, 0, "dup", 3) == 5);
+	check(jsmn_dom_delete_name(&p, tokens, 2048, 0, 7) == 0);
+	check(jsmn_dom_get_utf8_name(&p, js, sizeof(js), tokens, 2048, 0, "k0", 2) == -1);
+	check(jsmn_dom_get_utf8_name(&p, js, sizeof(js), tokens, 2048, 0, "k1", 2) == 9);
+	p.pos = strlen(js) + 1;
+	name_i = jsmn_dom_new_string(&p, js, sizeof(js), tokens, 2048, "k0");
+	value_i = jsmn_dom_new_primitive(&p, js, sizeof(js), tokens, 2048, "7");
+	check(jsmn_dom_insert_name(&p, tokens, 2048, 0, name_i, value_i) == 0);
+	check(jsmn_dom_get_utf8_name(&p, js, sizeof(js), tokens, 2048, 0, "k0", 2) == name_i);
+	check(p.indexes == &index);
+
+	/* Filling more than half of the slots drops back to a linear scan */
+	for (i = 0; i < 300; i++) {
+		sprintf(name, "n%d", i);
+		name_i = jsmn_dom_new_string(&p, js, sizeof(js), tokens, 2048, name);
+		value_i = jsmn_dom_new_primitive(&p, js, sizeof(js), tokens, 2048, "8");
+		check(jsmn_dom_insert_name(&p, tokens, 2048, 0, name_i, value_i) == 0);
+	}
+	check(p.indexes == NULL);
+	check(jsmn_dom_get_utf8_name(&p, js, sizeof(js), tokens, 2048, 0, "n299", 4) == name_i);
+	check(jsmn_dom_get_utf8_name(&p, js, sizeof(js), tokens, 2048, 0, "k0", 2) == name_i - 600);
+
+	/* Rebuilding larger, and one index per object */
+	check(jsmn_dom_index_object(&p, js, sizeof(js), tokens, 2048, 0, &index, slots, 1024) == JSMN_ERROR_NOMEM);
+	check(jsmn_dom_index_object(&p, js, sizeof(js), tokens, 2048, 0, &index, big, 2048) == 0);
+	check(jsmn_dom_index_object(&p, js, sizeof(js), tokens, 2048, 0, &index2, big, 2048) == 0);
+	check(p.indexes == &index2 && index2.next == NULL);
+	check(jsmn_dom_get_utf8_name(&p, js, sizeof(js), tokens, 2048, 0, "n299", 4) == name_i);
+	check(jsmn_dom_get_utf8_name(&p, js, sizeof(js), tokens, 2048, 0, "ab", 2) == 1);
+	jsmn_dom_unindex_object(&p, &index2);
+	check(p.indexes == NULL);
+	return 0;
+}
+int test_dom_double(void) {
+	static const struct {
+		const char *js;
+		unsigned long long bits;
+	} cases[] = {
+		{ "0", 0x0000000000000000ULL },
+		{ "-0", 0x8000000000000000ULL },
+		{ "1e5", 0x40F86A0000000000ULL },
+		{ "1E+5", 0x40F86A0000000000ULL },
+		{ "-2.5e-3", 0xBF647AE147AE147BULL },
+		{ "0.1", 0x3FB999999999999AULL },
+		{ "0.30000000000000004", 0x3FD3333333333334ULL },
+		{ "9007199254740993", 0x4340000000000000ULL },
+		{ "9007199254740993.0000000000000001", 0x4340000000000001ULL },
+		{ "2.2250738585072011e-308", 0x000FFFFFFFFFFFFFULL },
+		{ "4.9406564584124654e-324", 0x0000000000000001ULL },
+		{ "2.4703282292062327e-324", 0x0000000000000000ULL },
+		{ "2.4703282292062328e-324", 0x0000000000000001ULL },
+		{ "1.7976931348623157e308", 0x7FEFFFFFFFFFFFFFULL },
+		{ "1e400", 0x7FF0000000000000ULL },
+		{ "1e-400", 0x0000000000000000ULL },
+		{ "123456789012345678901234567890", 0x45F8EE90FF6C373EULL },
+		{ "7.038531e-26", 0x3AB5C87FB0000000ULL },
+		{ "8.988465674311579e+307", 0x7FDFFFFFFFFFFFFFULL },
+	};
+	union {
+		double value;
+		unsigned long long bits;
+	} u, v;
+	jsmntok_t tokens[4];
+	jsmn_parser p;
+	char js[64];
+	unsigned long long seed = 0x9E3779B97F4A7C15ULL;
+	int i;
+
+	for (i = 0; i < (int) (sizeof(cases) / sizeof(cases[0])); i++) {
+		sprintf(js, "[%s]", cases[i].js);
+		jsmn_init(&p);
+		check(jsmn_parse(&p, js, strlen(js), tokens, 4) == 2);
+		check(jsmn_dom_get_double(&p, js, sizeof(js), tokens, 4, 1, &u.value) == 0);
+		if (u.bits != cases[i].bits) {
+			fprintf(stderr, "%s: %016llx != %016llx\n", cases[i].js, u.bits, cases[i].bits);
+			fail();
+		}
+	}
+
+	/* Round trips of random finite doubles */
+	for (i = 0; i < 100000; i++) {
+		seed ^= seed << 13;
+		seed ^= seed >> 7;
+		seed ^= seed << 17;
+		v.bits = seed;
+		if ((v.bits >> 52 & 0x7FF) == 0x7FF) {
+			continue;
+		}
+		sprintf(js, "[%.17g]", v.value);
+		jsmn_init(&p);
+		check(jsmn_parse(&p, js, strlen(js), tokens, 4) == 2);
+		check(jsmn_dom_get_double(&p, js, sizeof(js), tokens, 4, 1, &u.value) == 0);
+		if (u.bits != v.bits) {
+			fprintf(stderr, "%s: %016llx != %016llx\n", js, u.bits, v.bits);
+			fail();
+		}
+	}
+
+	jsmn_init(&p);
+	check(jsmn_parse(&p, "[true]", 6, tokens, 4) == 2);
+	check(jsmn_dom_get_double(&p, "[true]", 6, tokens, 4, 1, &u.value) == JSMN_ERROR_INVAL);
+
+	return 0;
+}
+int test_dom_new_double(void) {
+	static const struct {
+		double value;
+		const char *js;
+	} cases[] = {
+		{ 0.0, "0" },
+		{ -0.0, "-0" },
+		{ 1.0, "1" },
+		{ -12.5, "-12.5" },
+		{ 0.1, "0.1" },
+		{ 0.3, "0.3" },
+		{ 1e20, "100000000000000000000" },
+		{ 1e21, "1e+21" },
+		{ 1e-6, "0.000001" },
+		{ 1e-7, "1e-7" },
+		{ 123456.789, "123456.789" },
+		{ 5e-324, "5e-324" },
+		{ 2.2250738585072014e-308, "2.2250738585072014e-308" },
+		{ 1.7976931348623157e308, "1.7976931348623157e+308" },
+		{ 9007199254740993.0, "9007199254740992" },
+	};
+	union {
+		double value;
+		unsigned long long bits;
+	} u, v;
+	static char js[256];
+	jsmntok_t tokens[4];
+	jsmn_parser p;
+	unsigned long long seed = 0x9E3779B97F4A7C15ULL;
+	jsmnint_t value_i;
+	int i;
+
+	for (i = 0; i < (int) (sizeof(cases) / sizeof(cases[0])); i++) {
+		jsmn_init(&p);
+		value_i = jsmn_dom_new_double(&p, js, sizeof(js), tokens, 4, cases[i].value);
+		check(value_i == 0);
+		if (tokens[0].end - tokens[0].start != (jsmnint_t) strlen(cases[i].js)
+		||  strncmp(js + tokens[0].start, cases[i].js, strlen(cases[i].js)) != 0) {
+			fprintf(stderr, "%.17g: %.*s != %s\n", cases[i].value, (int) (tokens[0].end - tokens[0].start), js + tokens[0].start, cases[i].js);
+			fail();
+		}
+	}
+
+	/* Round trips through jsmn_dom_get_double() */
+	for (i = 0; i < 100000; i++) {
+		seed ^= seed << 13;
+		seed ^= seed >> 7;
+		seed ^= seed << 17;
+		v.bits = seed;
+		if ((v.bits >> 52 & 0x7FF) == 0x7FF) {
+			continue;
+		}
+		jsmn_init(&p);
+		value_i = jsmn_dom_new_double(&p, js, sizeof(js), tokens, 4, v.value);
+		check(value_i == 0);
+		check(jsmn_dom_get_double(&p, js, sizeof(js), tokens, 4, value_i, &u.value) == 0);
+		if (u.bits != v.bits) {
+			fprintf(stderr, "%.*s: %016llx != %016llx\n", (int) (tokens[0].end - tokens[0].start), js + tokens[0].start, u.bits, v.bits);
+			fail();
+		}
+	}
+
+	v.bits = 0x7FF0000000000000ULL;
+	jsmn_init(&p);
+	check(jsmn_dom_new_double(&p, js, sizeof(js), tokens, 4, v.value) == JSMN_ERROR_INVAL);
+
+	return 0;
+}
+int test_dom_int64(void) {
+	static const struct {
+		const char *js;
+		int rc;
+		long long value;
+		int urc;
+		unsigned long long uvalue;
+	} cases[] = {
+		{ "0", 0, 0, 0, 0 },
+		{ "-0", 0, 0, 0, 0 },
+		{ "7", 0, 7, 0, 7 },
+		{ "-42", 0, -42, JSMN_ERROR_RANGE, 0 },
+		{ "12345678", 0, 12345678, 0, 12345678 },
+		{ "1700000000123456789", 0, 1700000000123456789LL, 0, 1700000000123456789ULL },
+		{ "000000000000000000000001", 0, 1, 0, 1 },
+		{ "9223372036854775807", 0, 0x7FFFFFFFFFFFFFFFLL, 0, 0x7FFFFFFFFFFFFFFFULL },
+		{ "9223372036854775808", JSMN_ERROR_RANGE, 0, 0, 0x8000000000000000ULL },
+		{ "-9223372036854775808", 0, -0x7FFFFFFFFFFFFFFFLL - 1, JSMN_ERROR_RANGE, 0 },
+		{ "-9223372036854775809", JSMN_ERROR_RANGE, 0, JSMN_ERROR_RANGE, 0 },
+		{ "18446744073709551615", JSMN_ERROR_RANGE, 0, 0, 0xFFFFFFFFFFFFFFFFULL },
+		{ "18446744073709551616", JSMN_ERROR_RANGE, 0, JSMN_ERROR_RANGE, 0 },
+		{ "100000000000000000000", JSMN_ERROR_RANGE, 0, JSMN_ERROR_RANGE, 0 },
+		{ "1234567890.5", JSMN_ERROR_INVAL, 0, JSMN_ERROR_INVAL, 0 },
+		{ "1e3", JSMN_ERROR_INVAL, 0, JSMN_ERROR_INVAL, 0 },
+		{ "-", JSMN_ERROR_INVAL, 0, JSMN_ERROR_INVAL, 0 },
+		{ "true", JSMN_ERROR_INVAL, 0, JSMN_ERROR_INVAL, 0 },
+	};
+	static char js[256];
+	jsmntok_t tokens[4];
+	jsmn_parser p;
+	long long value;
+	unsigned long long uvalue;
+	jsmnint_t value_i;
+	int i;
+
+	for (i = 0; i < (int) (sizeof(cases) / sizeof(cases[0])); i++) {
+		sprintf(js, "[%s]", cases[i].js);
+		jsmn_init(&p);
+		check(jsmn_parse(&p, js, strlen(js), tokens, 4) == 2);
+		value = 0;
+		uvalue = 0;
+		check(jsmn_dom_get_int64(&p, js, sizeof(js), tokens, 4, 1, &value) == cases[i].rc);
+		check(value == cases[i].value);
+		check(jsmn_dom_get_uint64(&p, js, sizeof(js), tokens, 4, 1, &uvalue) == cases[i].urc);
+		check(uvalue == cases[i].uvalue);
+	}
+
+	jsmn_init(&p);
+	value_i = jsmn_dom_new_int64(&p, js, sizeof(js), tokens, 4, -0x7FFFFFFFFFFFFFFFLL - 1);
+	check(value_i == 0);
+	check(strncmp(js, "-9223372036854775808 ", 21) == 0);
+	jsmn_init(&p);
+	value_i = jsmn_dom_new_uint64(&p, js, sizeof(js), tokens, 4, 0xFFFFFFFFFFFFFFFFULL);
+	check(value_i == 0);
+	check(strncmp(js, "18446744073709551615 ", 21) == 0);
+	jsmn_init(&p);
+	value_i = jsmn_dom_new_integer(&p, js, sizeof(js), tokens, 4, -2147483647 - 1);
+	check(value_i == 0);
+	check(strncmp(js, "-2147483648 ", 12) == 0);
+	jsmn_init(&p);
+	value_i = jsmn_dom_new_int64(&p, js, sizeof(js), tokens, 4, 0);
+	check(strncmp(js, "0 ", 2) == 0);
+
+	/* Round trips */
+	for (i = 0; i < 63; i++) {
+		jsmn_init(&p);
+		value_i = jsmn_dom_new_int64(&p, js, sizeof(js), tokens, 4, -(1LL << i) + 1);
+		check(jsmn_dom_get_int64(&p, js, sizeof(js), tokens, 4, value_i, &value) == 0);
+		check(value == -(1LL << i) + 1);
+		jsmn_init(&p);
+		value_i = jsmn_dom_new_uint64(&p, js, sizeof(js), tokens, 4, (1ULL << i) * 3 - 1);
+		check(jsmn_dom_get_uint64(&p, js, sizeof(js), tokens, 4, value_i, &uvalue) == 0);
+		check(uvalue == (1ULL << i) * 3 - 1);
+	}
+
+	return 0;
+}
+int test_dom_bulk(void) {
+	static char js[65536];
+	static jsmntok_t tokens[8192];
+	static double values[8192];
+	static long long ints[8192];
+	jsmn_parser p;
+	jsmnint_t stop_i;
+	double value;
+	size_t pos;
+	int i, n = 5000;
+
+	pos = sprintf(js, "[");
+	for (i = 0; i < n; i++) {
+		pos += sprintf(js + pos, "%s%d", i > 0 ? ", " : "", (i - n / 2) * 997);
+	}
+	pos += sprintf(js + pos, ", 1.5e300, -0.25, 123456789012345678, true, 7]");
+	jsmn_init(&p);
+	check(jsmn_parse(&p, js, strlen(js), tokens, 8192) == n + 6);
+
+	/* Doubles stop at the literal */
+	check(jsmn_dom_get_doubles(&p, js, strlen(js), tokens, 8192, 0, values, 8192, &stop_i) == n + 3);
+	check(stop_i == n + 4);
+	for (i = 0; i < n; i++) {
+		check(values[i] == (double) ((i - n / 2) * 997));
+	}
+	check(values[n] == 1.5e300 && values[n + 1] == -0.25 && values[n + 2] == 123456789012345678.0);
+	check(jsmn_dom_get_double(&p, js, strlen(js), tokens, 8192, n + 3, &value) == 0 && value == values[n + 2]);
+
+	/* Integers stop at the first float */
+	check(jsmn_dom_get_int64s(&p, js, strlen(js), tokens, 8192, 0, ints, 8192, &stop_i) == n);
+	check(stop_i == n + 1);
+	for (i = 0; i < n; i++) {
+		check(ints[i] == (i - n / 2) * 997);
+	}
+
+	check(jsmn_dom_get_doubles(&p, js, strlen(js), tokens, 8192, 0, values, n, &stop_i) == JSMN_ERROR_NOMEM);
+	check(jsmn_dom_get_doubles(&p, js, strlen(js), tokens, 8192, 1, values, 8192, &stop_i) == JSMN_ERROR_INVAL);
+
+	/* A whole array, and an empty one */
+	strcpy(js + pos - strlen(", true, 7]"), "]");
+	jsmn_init(&p);
+	check(jsmn_parse(&p, js, strlen(js), tokens, 8192) == n + 4);
+	check(jsmn_dom_get_doubles(&p, js, strlen(js), tokens, 8192, 0, values, 8192, &stop_i) == n + 3);
+	check(stop_i == -1);
+	jsmn_init(&p);
+	check(jsmn_parse(&p, "[]", 2, tokens, 8192) == 1);
+	check(jsmn_dom_get_int64s(&p, "[]", 2, tokens, 8192, 0, ints, 0, NULL) == 0);
+
+	return 0;
+}
+
+int test_dom_unescape(void) {
+	jsmn_parser p;
+	jsmntok_t t[8];
+	static jsmntok_t tokens[4];
+	static char js[8192];
+	static char buf[8192];
+	const char *s = "[\"a\\\"b\\\\\\/\\b\\f\\n\\r\\t\", \"\\u00e9\\u20AC\\uD83D\\uDE00\", \"\\uD800x\\uDC00\", "
+		"\"caf\xC3\xA9 \xC0\xAF\xE2\x82!\"]";
+	size_t pos;
+	int i;
+
+	jsmn_init(&p);
+	check(jsmn_parse(&p, s, strlen(s), t, 8) == 5);
+	check(jsmn_dom_get_utf8len(&p, s, strlen(s), t, 8, 1) == 10);
+	check(jsmn_dom_get_utf8(&p, s, strlen(s), t, 8, 1, buf, sizeof(buf)) == 10 && strcmp(buf, "a\"b\\/\b\f\n\r\t") == 0);
+	check(jsmn_dom_get_utf8len(&p, s, strlen(s), t, 8, 2) == 9);
+	check(jsmn_dom_get_utf8(&p, s, strlen(s), t, 8, 2, buf, sizeof(buf)) == 9 && strcmp(buf, "\xC3\xA9\xE2\x82\xAC\xF0\x9F\x98\x80") == 0);
+
+	/* Unpaired surrogates and bad UTF-8 are U+FFFD */
+	check(jsmn_dom_get_utf8(&p, s, strlen(s), t, 8, 3, buf, sizeof(buf)) == 7 && strcmp(buf, "\xEF\xBF\xBDx\xEF\xBF\xBD") == 0);
+	check(jsmn_dom_get_utf8len(&p, s, strlen(s), t, 8, 4) == 13);
+	check(jsmn_dom_get_utf8(&p, s, strlen(s), t, 8, 4, buf, sizeof(buf)) == 13 && strcmp(buf, "caf\xC3\xA9 \xEF\xBF\xBD\xEF\xBF\xBD!") == 0);
+
+	/* A short buffer ends on a whole character */
+	check(jsmn_dom_get_utf8(&p, s, strlen(s), t, 8, 2, buf, 6) == 5 && strcmp(buf, "\xC3\xA9\xE2\x82\xAC") == 0);
+	check(jsmn_dom_get_utf8(&p, s, strlen(s), t, 8, 2, buf, 5) == 2 && strcmp(buf, "\xC3\xA9") == 0);
+	check(jsmn_dom_get_utf8(&p, s, strlen(s), t, 8, 1, buf, 4) == 3 && strcmp(buf, "a\"b") == 0);
+
+	/* Strings longer than any internal buffer */
+	pos = sprintf(js, "[\"");
+	for (i = 0; i < 700; i++) {
+		pos += sprintf(js + pos, "\\u00e9x");
+	}
+	pos += sprintf(js + pos, "\"]");
+	jsmn_init(&p);
+	check(jsmn_parse(&p, js, pos, tokens, 4) == 2);
+	check(jsmn_dom_get_utf8len(&p, js, pos, tokens, 4, 1) == 2100);
+	check(jsmn_dom_get_utf8(&p, js, pos, tokens, 4, 1, buf, sizeof(buf)) == 2100);
+	for (i = 0; i < 700; i++) {
+		check(memcmp(buf + 3 * i, "\xC3\xA9x", 3) == 0);
+	}
+
+	return 0;
+}
+
+int test_dom_quote(void) {
+	jsmn_parser p;
+	jsmntok_t t[4];
+	char js[256];
+	const char value[] = "a \"quoted\" \\ path\b\f\n\r\t\x01\x1F\x7F caf\xC3\xA9, long enough to span vectors\0end";
+	const char *quoted = "\"a \\\"quoted\\\" \\\\ path\\b\\f\\n\\r\\t\\u0001\\u001F\x7F caf\xC3\xA9, long enough to span vectors\\u0000end\"";
+	char buf[256];
+
+	jsmn_init(&p);
+	check(jsmn_dom_new_utf8(&p, js, sizeof(js), t, 4, value, sizeof(value) - 1) == 0);
+	check(strcmp(js, quoted) == 0);
+	check(jsmn_dom_get_utf8(&p, js, sizeof(js), t, 4, 0, buf, sizeof(buf)) == (jsmnint_t) sizeof(value) - 1);
+	check(memcmp(buf, value, sizeof(value)) == 0);
+
+	/* No room for the whole string */
+	jsmn_init(&p);
+	check(jsmn_dom_new_utf8(&p, js, strlen(quoted) - 4, t, 4, value, sizeof(value) - 1) == JSMN_ERROR_NOMEM);
+	jsmn_init(&p);
+	check(jsmn_dom_new_utf8(&p, js, 20, t, 4, value, sizeof(value) - 1) == JSMN_ERROR_NOMEM);
+
+	return 0;
+}
+
+int test_dom_cache(void) {
+	jsmn_parser p;
+	jsmntok_t t[8];
+	jsmn_dom_cache cache[8];
+	char js[64];
+	char buf[64];
+	double d;
+	long long ll;
+	unsigned long long ull;
+
+	strcpy(js, "[\"\\u00e9\\n\", 1.5, 42, \"ab\"]");
+	jsmn_init(&p);
+	check(jsmn_parse(&p, js, strlen(js), t, 8) == 5);
+	jsmn_dom_cache_tokens(&p, cache, 8);
+
+	check(jsmn_dom_get_utf8len(&p, js, strlen(js), t, 8, 1) == 3);
+	check(jsmn_dom_get_utf32len(&p, js, strlen(js), t, 8, 1) == 2);
+	check(jsmn_dom_get_double(&p, js, strlen(js), t, 8, 2, &d) == 0 && d == 1.5);
+	check(jsmn_dom_get_int64(&p, js, strlen(js), t, 8, 3, &ll) == 0 && ll == 42);
+	check(cache[1].known == (JSMN_DOM_CACHE_UTF8LEN | JSMN_DOM_CACHE_UTF32LEN));
+	check(cache[2].known == JSMN_DOM_CACHE_DOUBLE && cache[3].known == JSMN_DOM_CACHE_INT64);
+
+	/* Repeated reads come from the cache, even with the bytes changed under it */
+	js[3] = 'x';
+	js[15] = '7';
+	js[18] = '9';
+	check(jsmn_dom_get_utf8len(&p, js, strlen(js), t, 8, 1) == 3);
+	check(jsmn_dom_get_utf32len(&p, js, strlen(js), t, 8, 1) == 2);
+	check(jsmn_dom_get_double(&p, js, strlen(js), t, 8, 2, &d) == 0 && d == 1.5);
+	check(jsmn_dom_get_int64(&p, js, strlen(js), t, 8, 3, &ll) == 0 && ll == 42);
+	check(jsmn_dom_get_uint64(&p, js, strlen(js), t, 8, 3, &ull) == 0 && ull == 92);
+
+	/* Setting a token drops its entry, setting it from another copies that one */
+	check(jsmn_dom_set(&p, t, 8, 2, JSMN_PRIMITIVE, t[2].start, t[2].end) == 0);
+	check(cache[2].known == 0);
+	check(jsmn_dom_get_double(&p, js, strlen(js), t, 8, 2, &d) == 0 && d == 1.7);
+	check(jsmn_dom_set_from(&p, t, 8, 4, 3) == 0);
+	check(jsmn_dom_get_int64(&p, js, strlen(js), t, 8, 4, &ll) == 0 && ll == 42);
+
+	/* A whole string read records its length */
+	strcpy(js, "[\"a\\tb\", \"\\u20ac\\u20ac\"]");
+	jsmn_init(&p);
+	jsmn_dom_cache_tokens(&p, cache, 8);
+	check(jsmn_parse(&p, js, strlen(js), t, 8) == 3);
+	check(jsmn_dom_get_utf8(&p, js, strlen(js), t, 8, 1, buf, sizeof(buf)) == 3);
+	check(cache[1].known == JSMN_DOM_CACHE_UTF8LEN && cache[1].utf8len == 3);
+	check(jsmn_dom_get_utf8(&p, js, strlen(js), t, 8, 2, buf, 7) == 6);
+	check(cache[2].known == 0);
+
+	/* Without a cache nothing is kept */
+	jsmn_dom_cache_tokens(&p, NULL, 0);
+	check(jsmn_dom_get_utf8len(&p, js, strlen(js), t, 8, 2) == 6);
+	check(cache[2].known == 0);
+
+	return 0;
+}
+
+int test_dom_dirty(void) {
+	jsmn_parser p;
+	jsmntok_t t[16];
+	char js[128];
+	jsmnint_t v;
+#ifdef JSMN_EMITTER
+	jsmn_emitter e;
+	char out[128];
+#endif
+
+	strcpy(js, "{\"a\": [1,2],  \"b\": {\"c\": 3}, \"d\": [4]}");
+	jsmn_init(&p);
+	check(jsmn_parse(&p, js, strlen(js), t, 16) == 12);
+	check(!(t[0].flags & JSMN_DOM_DIRTY) && !(t[2].flags & JSMN_DOM_DIRTY));
+	check(!(t[6].flags & JSMN_DOM_DIRTY) && !(t[10].flags & JSMN_DOM_DIRTY));
+#ifdef JSMN_EMITTER
+	/* Untouched, the whole document is copied as it was written */
+	jsmn_init_emitter(&e);
+	check(jsmn_emit(&p, js, sizeof(js), t, 16, &e, out, sizeof(out)) == (jsmnint_t) strlen(js));
+	check(strcmp(out, js) == 0);
+#endif
+
+	/* A change marks its containers up to the root, and only those */
+	v = jsmn_dom_new_primitive(&p, js, sizeof(js), t, 16, "5");
+	check(v == 12);
+	check(jsmn_dom_replace(&p, t, 16, 8, v) == 0);
+	check((t[0].flags & JSMN_DOM_DIRTY) && (t[6].flags & JSMN_DOM_DIRTY));
+	check(!(t[2].flags & JSMN_DOM_DIRTY) && !(t[10].flags & JSMN_DOM_DIRTY));
+	check(t[8].flags == JSMN_PRIMITIVE_INTEGER && t[v].flags == JSMN_PRIMITIVE_INTEGER);
+#ifdef JSMN_EMITTER
+	jsmn_init_emitter(&e);
+	check(jsmn_emit(&p, js, sizeof(js), t, 16, &e, out, sizeof(out)) > 0);
+	check(strcmp(out, "{\"a\": [1,2], \"b\": {\"c\": 5}, \"d\": [4]}") == 0);
+
+	/* A clean container that does not fit is copied on over the next calls */
+	jsmn_init_emitter(&e);
+	e.cursor_i = 10;
+	check(jsmn_emit(&p, js, sizeof(js), t, 16, &e, out, 3) == 2);
+	check(strcmp(out, "[4") == 0);
+	check(jsmn_emit(&p, js, sizeof(js), t, 16, &e, out, 3) == 2);
+	check(strcmp(out, "]}") == 0);
+#endif
+
+	/* Setting a container from a clean one gives a new, changed container */
+	v = jsmn_dom_new(&p, t, 16);
+	check(jsmn_dom_set_from(&p, t, 16, v, 2) == 0);
+	check(t[v].flags & JSMN_DOM_DIRTY);
+	check(jsmn_dom_move(&p, t, 16, 10, 4) == 0);
+	check(t[2].flags & JSMN_DOM_DIRTY);
+
+	return 0;
+}
+#endif
+
+#ifdef JSMN_VALIDATE_UTF8
+static int utf8_parse(const char *s, size_t n) {
+	jsmn_parser p;
+	jsmntok_t t[4];
+	char js[256];
+
+	js[0] = '[';
+	js[1] = '"';
+	memcpy(js + 2, s, n);
+	js[n + 2] = '"';
+	js[n + 3] = ']';
+	jsmn_init(&p);
+	return jsmn_parse(&p, js, n + 4, t, 4);
+}
+
+int test_utf8(void) {
+	static const char *const good[] = {
+		"", "plain", "\xC3\xA9", "\xC2\x80\xDF\xBF", "\xE0\xA0\x80", "\xED\x9F\xBF", "\xEE\x80\x80",
+		"\xEF\xBF\xBF", "\xF0\x90\x80\x80", "\xF4\x8F\xBF\xBF", "a\xE2\x82\xAC" "b", "\\u00e9\xC3\xA9"
+	};
+	static const char *const bad[] = {
+		"\x80", "\xBF", "\xC0\x80", "\xC1\xBF", "\xC3", "\xC3" "a", "\xE0\x9F\xBF", "\xE2\x82",
+		"\xE2\x82" "a", "\xED\xA0\x80", "\xED\xBF\xBF", "\xF0\x8F\xBF\xBF", "\xF4\x90\x80\x80",
+		"\xF5\x80\x80\x80", "\xF8\x88\x80\x80\x80", "\xFF", "\xC3\xA9\xA9", "\xF0\x90\x80"
+	};
+	char s[160];
+	size_t i;
+	size_t at;
+	size_t n;
+
+	for (i = 0; i < sizeof(good) / sizeof(good[0]); i++) {
+		check(utf8_parse(good[i], strlen(good[i])) == 2);
+	}
+	for (i = 0; i < sizeof(bad) / sizeof(bad[0]); i++) {
+		check(utf8_parse(bad[i], strlen(bad[i])) == JSMN_ERROR_INVAL);
+	}
+
+	/* sequences across and at the end of vectors */
+	for (at = 0; at < 70; at++) {
+		for (i = 0; i < sizeof(good) / sizeof(good[0]); i++) {
+			n = strlen(good[i]);
+			memset(s, 'x', at);
+			memcpy(s + at, good[i], n);
+			memset(s + at + n, 'y', 3);
+			check(utf8_parse(s, at + n) == 2);
+			check(utf8_parse(s, at + n + 3) == 2);
+		}
+		for (i = 0; i < sizeof(bad) / sizeof(bad[0]); i++) {
+			n = strlen(bad[i]);
+			memset(s, 'x', at);
+			memcpy(s + at, bad[i], n);
+			memset(s + at + n, 'y', 3);
+			check(utf8_parse(s, at + n) == JSMN_ERROR_INVAL);
+			check(utf8_parse(s, at + n + 3) == JSMN_ERROR_INVAL);
+		}
+	}
+
+	/* multibyte runs longer than a vector */
+	for (i = 0; i < 40; i++) {
+		memcpy(s + 3 * i, "\xE2\x82\xAC", 3);
+	}
+	check(utf8_parse(s, 120) == 2);
+	check(utf8_parse(s, 119) == JSMN_ERROR_INVAL);
+	s[64] = '\xC0';
+	check(utf8_parse(s, 120) == JSMN_ERROR_INVAL);
+	return 0;
+}
+#endif
+
+#ifdef JSMN_SAX
+struct sax_events {
+	jsmntype_t type[64];
+	jsmnint_t start[64], end[64];
+	int key[64];
+	int open[16];
+	int n, depth, stop;
+	int stop_rc; /* what the callback returns at event `stop` */
+};
+
+static int sax_event(struct sax_events *e, jsmntype_t type, jsmnint_t start, jsmnint_t end, int key) {
+	e->type[e->n] = type;
+	e->start[e->n] = start;
+	e->end[e->n] = end;
+	e->key[e->n] = key;
+	e->n++;
+	return e->n == e->stop ? e->stop_rc : 0;
+}
+static int sax_begin_object(void *ctx, jsmnint_t start) {
+	struct sax_events *e = (struct sax_events *) ctx;
+	e->open[e->depth++] = e->n;
+	return sax_event(e, JSMN_OBJECT, start, -1, 0);
+}
+static int sax_begin_array(void *ctx, jsmnint_t start) {
+	struct sax_events *e = (struct sax_events *) ctx;
+	e->open[e->depth++] = e->n;
+	return sax_event(e, JSMN_ARRAY, start, -1, 0);
+}
+static int sax_end(void *ctx, jsmnint_t end) {
+	struct sax_events *e = (struct sax_events *) ctx;
+	e->end[e->open[--e->depth]] = end;
+	return 0;
+}
+static int sax_key(void *ctx, jsmnint_t start, jsmnint_t end) {
+	return sax_event((struct sax_events *) ctx, JSMN_STRING, start, end, 1);
+}
+static int sax_string(void *ctx, jsmnint_t start, jsmnint_t end) {
+	return sax_event((struct sax_events *) ctx, JSMN_STRING, start, end, 0);
+}
+static int sax_primitive(void *ctx, jsmnint_t start, jsmnint_t end) {
+	return sax_event((struct sax_events *) ctx, JSMN_PRIMITIVE, start, end, 0);
+}
+static const jsmn_sax sax_recorder = {
+	sax_begin_object, sax_end, sax_begin_array, sax_end, sax_key, sax_string, sax_primitive
+};
+
+/* Streams `js` through the callbacks in `step` byte pieces and compares with jsmn_parse().
+ * Out of strict mode a primitive cut at the end of a piece is complete, so take it whole. */
+static int sax_same(const char *js, size_t step) {
+	struct sax_events e;
+	jsmn_parser p;
+	jsmntok_t t[64];
+	jsmnint_t r, n;
+	size_t len = strlen(js), have;
+	int i;
+
+#ifndef JSMN_STRICT
+	step = len;
+#endif
+	memset(&e, 0, sizeof(e));
+	jsmn_init(&p);
+	for (have = step; ; have += step) {
+		r = jsmn_parse_sax(&p, js, have < len ? have : len, &sax_recorder, &e);
+		if (have >= len || (r < 0 && r != JSMN_ERROR_PART)) {
+			break;
+		}
+	}
+	jsmn_init(&p);
+	n = jsmn_parse(&p, js, len, t, 64);
+	if (r != n || e.n != n || e.depth != 0) {
+		return 0;
+	}
+	for (i = 0; i < n; i++) {
+		/* compact containers have no end, keys may be primitives out of strict mode */
+		if ((e.type[i] != JSMN_TOK_TYPE(&t[i]) && !e.key[i]) || e.start[i] != JSMN_TOK_START(&t[i]) ||
+				(e.end[i] != JSMN_TOK_END(&t[i]) && JSMN_TOK_END(&t[i]) != -1) ||
+				e.key[i] != (JSMN_TOK_SIZE(&t[i]) == 1 && e.type[i] != JSMN_OBJECT && e.type[i] != JSMN_ARRAY)) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+int test_sax(void) {
+	static const char *const docs[] = {
+		"{}", "[]", "\"a\"", "[1]",
+		"{\"a\": 0, \"b\": [1, true, null, \"x\\\"y\"], \"c\": {\"d\": {}, \"e\": []}}",
+		"[{\"a\": \"b\"}, [[], {}], -1.5e3, \"\\u00e9\"]",
+		"{\"a\": 1} [2] \"c\""
+	};
+	const char *js;
+	struct sax_events e;
+	jsmn_parser p;
+	jsmn_sax none;
+	unsigned int i;
+	size_t step;
+
+	for (i = 0; i < sizeof(docs) / sizeof(docs[0]); i++) {
+		for (step = 1; step <= 8; step++) {
+			check(sax_same(docs[i], step));
+		}
+	}
+
+	/* Stopping in a callback, and resuming after that value */
+	js = "[1, {\"a\": \"b\"}, 2]";
+	memset(&e, 0, sizeof(e));
+	e.stop = 3;
+	e.stop_rc = 7;
+	jsmn_init(&p);
+	check(jsmn_parse_sax(&p, js, strlen(js), &sax_recorder, &e) == JSMN_ERROR_STOPPED);
+	check(p.sax_stop == 7);
+	check(e.n == 3 && e.key[2] == 0 && e.type[2] == JSMN_OBJECT && p.pos == 5);
+	check(jsmn_parse_sax(&p, js, strlen(js), &sax_recorder, &e) == 6);
+	check(e.n == 6 && e.key[3] == 1 && e.end[2] == 14 && e.end[0] == 18);
+
+	/* A callback value that looks like an error code is not taken for one */
+	memset(&e, 0, sizeof(e));
+	e.stop = 2;
+	e.stop_rc = JSMN_ERROR_PART;
+	jsmn_init(&p);
+	check(jsmn_parse_sax(&p, js, strlen(js), &sax_recorder, &e) == JSMN_ERROR_STOPPED);
+	check(p.sax_stop == JSMN_ERROR_PART && e.n == 2 && p.pos == 2);
+
+	/* No callbacks at all */
+	memset(&none, 0, sizeof(none));
+	jsmn_init(&p);
+	check(jsmn_parse_sax(&p, js, strlen(js), &none, NULL) == 6);
+
+	jsmn_init(&p);
+	check(jsmn_parse_sax(&p, "[1}", 3, &none, NULL) == JSMN_ERROR_INVAL);
+	jsmn_init(&p);
+	check(jsmn_parse_sax(&p, "]", 1, &none, NULL) == JSMN_ERROR_INVAL);
+	jsmn_init(&p);
+	check(jsmn_parse_sax(&p, "{\"a\": [1, ", 10, &none, NULL) == JSMN_ERROR_PART);
+#ifdef JSMN_STRICT
+	jsmn_init(&p);
+	check(jsmn_parse_sax(&p, "{1: 2}", 6, &none, NULL) == JSMN_ERROR_INVAL);
+	jsmn_init(&p);
+	check(jsmn_parse_sax(&p, "{[]: 2}", 7, &none, NULL) == JSMN_ERROR_INVAL);
+#else
+	check(sax_same("{a: 0, b: [c, d]}", 3));
+#endif
+	return 0;
+}
+#endif
+
+#ifdef JSMN_THREADS
+static unsigned long gen_seed;
+
+static unsigned int gen_rand(unsigned int n) {
+	gen_seed = gen_seed * 1103515245 + 12345;
+	return (unsigned int) ((gen_seed >> 16) % n);
+}
+
+/* Appends a random JSON value, with random whitespace */
+static size_t gen_value(char *js, size_t pos, size_t cap, int depth) {
+	static const char *const strings[] = {"a", "\\\"[,{\\\\", "\\u00e9,", "x\\\\", ",:{}[]", ""};
+	static const char *const primitives[] = {"1", "-2.5e3", "true", "false", "null", "12345678"};
+	unsigned int n, k;
+
+	if (pos + 64 > cap) {
+		return pos;
+	}
+	js[pos++] = gen_rand(4) == 0 ? ' ' : (gen_rand(2) ? '\n' : '\t');
+	switch (depth < 6 ? gen_rand(4) : 2 + gen_rand(2)) {
+		case 0: case 1:
+			k = gen_rand(2);
+			js[pos++] = k ? '{' : '[';
+			n = gen_rand(6);
+			while (n-- > 0 && pos + 64 <= cap) {
+				if (k) {
+					pos += sprintf(js + pos, "\"%s\": ", strings[gen_rand(6)]);
+				}
+				pos = gen_value(js, pos, cap, depth + 1);
+				if (n > 0) {
+					js[pos++] = ',';
+				}
+			}
+			if (js[pos - 1] == ',') {
+				pos--;
+			}
+			js[pos++] = k ? '}' : ']';
+			break;
+		case 2:
+			pos += sprintf(js + pos, "\"%s\"", strings[gen_rand(6)]);
+			break;
+		default:
+			pos += sprintf(js + pos, "%s", primitives[gen_rand(6)]);
+			break;
+	}
+	return pos;
+}
+
+static int same_tokens(jsmntok_t *a, jsmntok_t *b, int n) {
+	int i;
+	for (i = 0; i < n; i++) {
+		if (JSMN_TOK_TYPE(&a[i]) != JSMN_TOK_TYPE(&b[i]) ||
+				JSMN_TOK_START(&a[i]) != JSMN_TOK_START(&b[i]) ||
+				JSMN_TOK_END(&a[i]) != JSMN_TOK_END(&b[i]) ||
+				JSMN_TOK_SIZE(&a[i]) != JSMN_TOK_SIZE(&b[i])) {
+			return 0;
+		}
+#ifdef JSMN_PARENT_LINKS
+		if (a[i].parent != b[i].parent) {
+			return 0;
+		}
+#endif
+#ifdef JSMN_SKIP_LINKS
+		if (a[i].skip != b[i].skip) {
+			return 0;
+		}
+#endif
+	}
+	return 1;
+}
+
+/* Parses `js` both ways and compares the outcome */
+static int same_parse(const char *js, size_t len, unsigned int num_tokens, unsigned int nthreads) {
+	jsmn_parser p1, p2;
+	jsmntok_t *t1 = malloc(num_tokens * sizeof(jsmntok_t));
+	jsmntok_t *t2 = malloc(num_tokens * sizeof(jsmntok_t));
+	jsmnint_t r1, r2;
+	int ok;
+
+	jsmn_init(&p1);
+	jsmn_init(&p2);
+	r1 = jsmn_parse(&p1, js, len, t1, num_tokens);
+	r2 = jsmn_parse_parallel(&p2, js, len, t2, num_tokens, nthreads);
+	ok = r1 == r2 && p1.pos == p2.pos && p1.toknext == p2.toknext && p1.toksuper == p2.toksuper &&
+		same_tokens(t1, t2, p1.toknext);
+	if (!ok) {
+		printf("parallel %d (pos %d), sequential %d (pos %d), %u threads: %.*s\n",
+				(int) r2, (int) p2.pos, (int) r1, (int) p1.pos, nthreads, (int) len, js);
+	}
+	free(t1);
+	free(t2);
+	return ok;
+}
+
+int test_parse_parallel(void) {
+	static const unsigned int threads[] = {2, 3, 4, 7, 16, 64};
+	char js[16384];
+	size_t len, cut;
+	int i, k;
+
+	gen_seed = 1;
+	for (i = 0; i < 100; i++) {
+		len = gen_value(js, 0, sizeof(js) - 1, 0);
+		js[len] = '\0';
+		for (k = 0; k < 6; k++) {
+			check(same_parse(js, len, 4096, threads[k]));
+		}
+		/* Not enough tokens */
+		check(same_parse(js, len, 8, 4));
+		/* Truncated */
+		cut = gen_rand((unsigned int) len);
+		check(same_parse(js, cut, 4096, 4));
+		/* Corrupted */
+		js[gen_rand((unsigned int) len)] = "\"\\,:{}[] a0"[gen_rand(11)];
+		check(same_parse(js, len, 4096, 4));
+	}
+
+	/* Several top-level values, and a closing bracket in a primitive */
+	strcpy(js, "[1, 2, 3] {\"a\": [4, 5]} \"b\", 6, [7, [8, [9]]], \"c\": 10, 11");
+	for (i = 0; i < 40; i++) {
+		strcat(js, ", [12, {\"d\": 13}]");
+	}
+	check(same_parse(js, strlen(js), 4096, 8));
+	strcat(js, ", a]b");
+	check(same_parse(js, strlen(js), 4096, 8));
+	return 0;
+}
+
+int test_parse_ndjson(void) {
+	static char js[1 << 16];
+	static jsmntok_t tok[8192], t[4096];
+	jsmn_record rec[512];
+	jsmn_parser p;
+	size_t len = 0, start, i;
+	jsmnint_t n, r, k;
+	unsigned int lines = 0, nthreads;
+
+	gen_seed = 7;
+	while (len + 256 < sizeof(js) / 2 && lines < 400) {
+		start = len;
+		len = gen_value(js, len, start + 2048, 0);
+		for (i = start; i < len; i++) {
+			if (js[i] == '\n') {
+				js[i] = ' ';
+			}
+		}
+		switch (gen_rand(8)) {
+			case 0: js[len++] = '\r'; break;                            /* CRLF */
+			case 1: js[len++] = '\n'; js[len++] = ' '; break;           /* blank line */
+			case 2: js[start + gen_rand((unsigned int) (len - start))] = '{'; break; /* bad line */
+		}
+		js[len++] = '\n';
+		lines++;
+	}
+
+	check(jsmn_parse_ndjson(js, len, NULL, 0, NULL, 0, 4) == (jsmnint_t) lines);
+	check(jsmn_parse_ndjson(js, len, tok, 8192, rec, 10, 4) == JSMN_ERROR_NOMEM);
+
+	for (nthreads = 1; nthreads <= 8; nthreads *= 2) {
+		n = jsmn_parse_ndjson(js, len, tok, 8192, rec, 512, nthreads);
+		check(n == (jsmnint_t) lines);
+		for (k = 0; k < n; k++) {
+			check(js[rec[k].end] == '\n');
+			jsmn_init(&p);
+			p.pos = rec[k].start;
+			r = jsmn_parse(&p, js, rec[k].end, t, 4096);
+			check(r == rec[k].count);
+			check(r < 0 || same_tokens(t, tok + rec[k].first, r));
+			check(k == 0 || rec[k].first >= rec[k - 1].first);
+		}
+	}
+
+	/* Counting only lays out the same arena */
+	check(jsmn_parse_ndjson(js, len, NULL, 0, rec, 512, 4) == (jsmnint_t) lines);
+	for (k = 0, r = 0; k < (jsmnint_t) lines; k++) {
+		check(rec[k].first == r);
+		r += rec[k].count > 0 ? rec[k].count : 0;
+	}
+
+	/* An arena too small fails the records that do not fit, not the batch */
+	check(jsmn_parse_ndjson(js, len, tok, 64, rec, 512, 4) == (jsmnint_t) lines);
+	check(rec[lines - 1].count == JSMN_ERROR_NOMEM);
+	check(rec[0].count != JSMN_ERROR_NOMEM);
+
+	/* Blank lines and a last line without '\n' */
+	check(jsmn_parse_ndjson("\n \r\n{\"a\": 1}\n\n[2]", 17, tok, 8, rec, 4, 2) == 2);
+	check(rec[0].line == 3 && rec[0].count == 3 && rec[0].first == 0);
+	check(rec[1].line == 5 && rec[1].count == 2 && rec[1].first == 3 && rec[1].end == 17);
+	check(tokeq("\n \r\n{\"a\": 1}\n\n[2]", tok, 5,
+				JSMN_OBJECT, 4, 12, 1,
+				JSMN_STRING, "a", 1,
+				JSMN_PRIMITIVE, "1",
+				JSMN_ARRAY, 14, 17, 1,
+				JSMN_PRIMITIVE, "2"));
+	return 0;
+}
+#endif
+
+#ifdef JSMN_LARGE
+int test_large(void) {
+	/* A sparse file just over 4 GiB, with a document straddling the 4 GiB mark */
+	const char *doc = "[\"abcdefghijklmnop\", 12345678901]";
+	const size_t base = ((size_t) 1 << 32) - 8;
+	const size_t len = base + 4096;
+	char path[] = "/tmp/jsmn-large-XXXXXX";
+	jsmn_parser p;
+	jsmntok_t tok[4];
+	const char *js;
+	int fd;
+	jsmnint_t r;
+
+	if (sizeof(size_t) < 8) {
+		return 0;
+	}
+
+	fd = mkstemp(path);
+	check(fd >= 0);
+	unlink(path);
+	check(ftruncate(fd, (off_t) len) == 0);
+	check(pwrite(fd, doc, strlen(doc), (off_t) base) == (ssize_t) strlen(doc));
+	js = (const char *) mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	check(js != MAP_FAILED);
+
+	/* Everything before the document is zero: resume the parser right at it */
+	jsmn_init(&p);
+	p.pos = base;
+	r = jsmn_parse(&p, js, len, tok, 4);
+	check(r == 3);
+	check(p.pos > ((size_t) 1 << 32));
+	check(tok[0].type == JSMN_ARRAY);
+	check(tok[0].start == (jsmnint_t) base);
+	check(tok[0].end == (jsmnint_t) (base + strlen(doc)));
+	check(tok[1].type == JSMN_STRING);
+	check(tok[1].start == (jsmnint_t) base + 2);
+	check(tok[1].end == (jsmnint_t) base + 18);
+	check(tok[2].type == JSMN_PRIMITIVE);
+	check(tok[2].start == (jsmnint_t) base + 21);
+	check(js[tok[2].start] == '1');
+
+	munmap((void *) js, len);
+	return 0;
+}
+#endif
+
+#ifdef JSMN_SIMD
+int test_count_tokens(void) {
+	int i;
+	int j;
+	int pos;
+	jsmn_parser p;
+	unsigned int depth;
+	char js[512];
+	const char *docs[] = {
+		"{}",
+		"[[], [[]], [[], []]]",
+		"[\"a\", [[], []]]",
+		"[[], \"[], [[]]\", [[]]]",
+		"[1, 2, [3, \"a\"], null]",
+		"{\"a\":\"\\\"}\", \"b\\\\\": [true,false], \"c\": {\"d\": -1.5e+3}}",
+		"{\"x\": \"va\\\\ue\", \"y\": \"value y\"}  \t\n",
+	};
+
+	for (i = 0; i < (int) (sizeof(docs) / sizeof(docs[0])); i++) {
+		jsmn_init(&p);
+		check(jsmn_count_tokens(docs[i], strlen(docs[i]), NULL) == jsmn_parse(&p, docs[i], strlen(docs[i]), NULL, 0));
+	}
+
+	check(jsmn_count_tokens("[[], [[1]], [[], [{\"a\": 2}]]]", 29, &depth) == 11);
+	check(depth == 4);
+	check(jsmn_count_tokens("[\"[[[\", 1]\0[[[[", 15, &depth) == 3);
+	check(depth == 1);
+
+	/* backslash runs and strings across 64-byte blocks */
+	for (i = 0; i < 64; i++) {
+		pos = 0;
+		js[pos++] = '[';
+		memset(js + pos, ' ', i);
+		pos += i;
+		for (j = 0; j < 16; j++) {
+			js[pos++] = '\"';
+			memset(js + pos, '\\', j);
+			pos += j;
+			if (j % 2 == 1) {
+				js[pos++] = '\"';
+			}
+			js[pos++] = '\"';
+			js[pos++] = ',';
+		}
+		js[pos - 1] = ']';
+		js[pos] = '\0';
+		jsmn_init(&p);
+		check(jsmn_count_tokens(js, strlen(js), &depth) == 17);
+		check(jsmn_parse(&p, js, strlen(js), NULL, 0) == 17);
+		check(depth == 1);
+	}
+	return 0;
+}
+#endif
+
 int test_nonstrict(void) {
 #ifndef JSMN_STRICT
 	const char *js;
@@ -405,7 +1836,7 @@ int test_emitter(void) {
 	rc = jsmn_emit( &p, js, strlen(js), tokens, 1024, &e, outjs, 1024);
 	if (strcmp(injs, outjs) != 0) {
 		fprintf(stderr, "jsmn_emit() = %i\n", rc);
-		fprintf(stderr, "pos: %i\njs   : %s\noutjs: %s\n", p.pos, js, outjs);
+		fprintf(stderr, "pos: %i\njs   : %s\noutjs: %s\n", (int) p.pos, js, outjs);
 		return -1;
 	}
 	/* 
@@ -531,12 +1962,245 @@ int test_emitter(void) {
 	rc = jsmn_emit( &p, js, strlen(js), tokens, 1024, &e, outjs, 1024);
 	if (strcmp(passjs, outjs) != 0) {
 		fprintf(stderr, "jsmn_emit() = %i\n", rc);
-		fprintf(stderr, "pos: %i\njs    : %s\npassjs: %s\noutjs : %s\n", p.pos, js, passjs, outjs);
+		fprintf(stderr, "pos: %i\njs    : %s\npassjs: %s\noutjs : %s\n", (int) p.pos, js, passjs, outjs);
 		return -1;
 	}
 
 	return 0;
 }
+
+/* Emits all of `t` through `outlen` bytes of buffer at a time into `out` */
+static size_t emit_chunks(jsmn_parser *p, char *js, size_t len, jsmntok_t *t, jsmnuint_t num_tokens, size_t outlen, char *out) {
+	jsmn_emitter e;
+	char buf[1024];
+	size_t pos;
+	jsmnint_t rc;
+
+	pos = 0;
+	jsmn_init_emitter(&e);
+	while ((rc = jsmn_emit(p, js, len, t, num_tokens, &e, buf, outlen)) > 0) {
+		memcpy(&out[pos], buf, rc);
+		pos += rc;
+	}
+	out[pos] = '\0';
+	return pos;
+}
+
+int test_emit_chunks(void) {
+	jsmn_parser p;
+	jsmntok_t t[16];
+	char js[256];
+	char out[256];
+	char chunked[256];
+#ifdef JSMN_EMIT_IOV
+	jsmn_emitter e;
+	struct iovec iov[16];
+	char scratch[16];
+	int n;
+	int k;
+	size_t pos;
+#endif
+
+	/* An untouched document comes out the same whatever the buffer size */
+	strcpy(js, "{\"a\" :  [1,   2,\n 3], \"b\":{ \"c\" : \"\\/x\" }}");
+	jsmn_init(&p);
+	check(jsmn_parse(&p, js, strlen(js), t, 16) == 10);
+	check(emit_chunks(&p, js, sizeof(js), t, 16, 1024, out) == strlen(js));
+	check(strcmp(out, js) == 0);
+	/* one byte and its terminator at a time */
+	check(emit_chunks(&p, js, sizeof(js), t, 16, 2, chunked) == strlen(js));
+	check(strcmp(chunked, out) == 0);
+	check(emit_chunks(&p, js, sizeof(js), t, 16, 9, chunked) == strlen(js));
+	check(strcmp(chunked, out) == 0);
+#ifdef JSMN_EMIT_IOV
+	pos = 0;
+	jsmn_init_emitter(&e);
+	n = jsmn_emit_iov(&p, js, sizeof(js), t, 16, &e, iov, 16, scratch, sizeof(scratch));
+	check(n > 0 && e.cursor_i == -1);
+	for (k = 0; k < n; k++) {
+		memcpy(&chunked[pos], iov[k].iov_base, iov[k].iov_len);
+		pos += iov[k].iov_len;
+	}
+	chunked[pos] = '\0';
+	check(strcmp(chunked, out) == 0);
+
+	/* Picking up a span jsmn_emit() stopped in */
+	jsmn_init_emitter(&e);
+	check(jsmn_emit(&p, js, sizeof(js), t, 16, &e, chunked, 9) == 8);
+	n = jsmn_emit_iov(&p, js, sizeof(js), t, 16, &e, iov, 16, scratch, sizeof(scratch));
+	check(n == 1 && iov[0].iov_base == &js[8] && iov[0].iov_len == strlen(js) - 8);
+#endif
+	return 0;
+}
+#endif
+
+#ifdef JSMN_EMIT_IOV
+/* Emits all of `t` three entries and `scratch_len` bytes of scratch at a time into `out` */
+static jsmnint_t emit_iov_all(jsmn_parser *p, char *js, size_t len, jsmntok_t *t, jsmnuint_t num_tokens, size_t scratch_len, char *out) {
+	jsmn_emitter e;
+	char scratch[8];
+	struct iovec iov[3];
+	int n;
+	int k;
+	size_t pos;
+
+	pos = 0;
+	jsmn_init_emitter(&e);
+	while (e.cursor_i != -1) {
+		n = jsmn_emit_iov(p, js, len, t, num_tokens, &e, iov, 3, scratch, scratch_len);
+		if (n <= 0) {
+			return n < 0 ? n : -1;
+		}
+		for (k = 0; k < n; k++) {
+			/* values are not copied */
+			if (!(((char *) iov[k].iov_base >= scratch && (char *) iov[k].iov_base < scratch + scratch_len) ||
+			      ((char *) iov[k].iov_base >= js      && (char *) iov[k].iov_base < js + len))) {
+				return -1;
+			}
+			memcpy(&out[pos], iov[k].iov_base, iov[k].iov_len);
+			pos += iov[k].iov_len;
+		}
+	}
+	out[pos] = '\0';
+	return pos;
+}
+
+int test_emit_iov(void) {
+	jsmn_parser p;
+	jsmn_emitter e;
+	jsmntok_t t[32];
+	char js[256];
+	char out[256];
+	char whole[256];
+	char scratch[4];
+	struct iovec iov[3];
+	jsmnint_t v;
+	jsmnint_t q;
+	jsmnint_t name;
+
+	strcpy(js, "{\"a\": [1,2],  \"b\": {\"c\": \"x\\ty\"}, \"d\": [true, null, \"\"]}");
+	jsmn_init(&p);
+	check(jsmn_parse(&p, js, strlen(js), t, 32) == 14);
+	v = jsmn_dom_new_primitive(&p, js, sizeof(js), t, 32, "5");
+	check(jsmn_dom_insert_value(&p, t, 32, 10, v) == 0);
+	jsmn_init_emitter(&e);
+	check(jsmn_emit(&p, js, sizeof(js), t, 32, &e, whole, sizeof(whole)) > 0);
+
+	/* A few entries and bytes of scratch at a time add up to what jsmn_emit writes */
+	check(emit_iov_all(&p, js, sizeof(js), t, 32, 4, out) == (jsmnint_t) strlen(whole));
+	check(strcmp(out, whole) == 0);
+
+	/* The untouched object is one entry pointing at its original text */
+	jsmn_init_emitter(&e);
+	e.cursor_i = 6;
+	check(jsmn_emit_iov(&p, js, sizeof(js), t, 32, &e, iov, 1, scratch, sizeof(scratch)) == 1);
+	check(iov[0].iov_base == &js[t[6].start] && iov[0].iov_len == strlen("{\"c\": \"x\\ty\"}"));
+
+	/* No room for anything */
+	jsmn_init_emitter(&e);
+	check(jsmn_emit_iov(&p, js, sizeof(js), t, 32, &e, iov, 3, scratch, 0) == JSMN_ERROR_NOMEM);
+
+	/* A name with no quotes around it in js takes both from scratch, the worst case */
+	q = jsmn_dom_new_primitive(&p, js, sizeof(js), t, 32, "q");
+	name = jsmn_dom_new(&p, t, 32);
+	check(jsmn_dom_set(&p, t, 32, name, JSMN_STRING, t[q].start, t[q].end) == 0);
+	v = jsmn_dom_new_primitive(&p, js, sizeof(js), t, 32, "6");
+	check(jsmn_dom_insert_name(&p, t, 32, 0, name, v) == 0);
+	jsmn_init_emitter(&e);
+	check(jsmn_emit(&p, js, sizeof(js), t, 32, &e, whole, sizeof(whole)) > 0);
+	check(strstr(whole, ", \"q\": 6}") != NULL);
+	check(emit_iov_all(&p, js, sizeof(js), t, 32, 4, out) == (jsmnint_t) strlen(whole));
+	check(strcmp(out, whole) == 0);
+	check(emit_iov_all(&p, js, sizeof(js), t, 32, 3, out) == JSMN_ERROR_NOMEM);
+
+	return 0;
+}
+#endif
+
+#ifdef JSMN_EMIT_SINKS
+/* Takes at most three bytes, and would block on every other call */
+static jsmnint_t slow_sink(void *ctx, const char *buf, size_t size) {
+	jsmn_membuf *mem = (jsmn_membuf *) ctx;
+	static int calls;
+
+	if (calls++ % 2 == 0) {
+		return 0;
+	}
+	return jsmn_sink_mem(mem, buf, size < 3 ? size : 3);
+}
+
+int test_emit_sink(void) {
+	jsmn_parser p;
+	jsmn_emitter e;
+	jsmn_writer w;
+	jsmntok_t t[32];
+	jsmn_membuf mem;
+	char js[256];
+	char whole[256];
+	char block[24];
+	char out[256];
+	int fds[2];
+	jsmnint_t rc;
+	jsmnint_t v;
+	int again;
+	ssize_t n;
+
+	strcpy(js, "{\"a\": [1,2],  \"b\": {\"c\": \"some longer text\"}, \"d\": [true, null]}");
+	jsmn_init(&p);
+	check(jsmn_parse(&p, js, strlen(js), t, 32) == 13);
+	v = jsmn_dom_new_primitive(&p, js, sizeof(js), t, 32, "5");
+	check(jsmn_dom_insert_value(&p, t, 32, 10, v) == 0);
+	jsmn_init_emitter(&e);
+	check(jsmn_emit(&p, js, sizeof(js), t, 32, &e, whole, sizeof(whole)) > 0);
+
+	/* A small block streams the whole document into memory */
+	memset(&mem, 0, sizeof(mem));
+	jsmn_init_emitter(&e);
+	jsmn_init_writer(&w, jsmn_sink_mem, &mem, block, sizeof(block), 8);
+	check(jsmn_emit_to(&p, js, sizeof(js), t, 32, &e, &w) == 0);
+	check(mem.len == strlen(whole) && memcmp(mem.data, whole, mem.len) == 0);
+
+	/* A capped buffer fails instead of growing */
+	mem.len = 0;
+	mem.max = 10;
+	jsmn_init_emitter(&e);
+	jsmn_init_writer(&w, jsmn_sink_mem, &mem, block, sizeof(block), 8);
+	check(jsmn_emit_to(&p, js, sizeof(js), t, 32, &e, &w) == JSMN_ERROR_NOMEM);
+
+	/* A sink that would block resumes where it stopped */
+	mem.len = 0;
+	mem.max = 0;
+	again = 0;
+	jsmn_init_emitter(&e);
+	jsmn_init_writer(&w, slow_sink, &mem, block, sizeof(block), sizeof(block));
+	while ((rc = jsmn_emit_to(&p, js, sizeof(js), t, 32, &e, &w)) == JSMN_ERROR_AGAIN) {
+		again++;
+	}
+	check(rc == 0 && again > 0);
+	check(mem.len == strlen(whole) && memcmp(mem.data, whole, mem.len) == 0);
+	free(mem.data);
+	memset(&mem, 0, sizeof(mem));
+
+	/* A string bigger than the block */
+	jsmn_init_emitter(&e);
+	e.cursor_i = 8;
+	jsmn_init_writer(&w, jsmn_sink_mem, &mem, block, 8, 8);
+	check(jsmn_emit_to(&p, js, sizeof(js), t, 32, &e, &w) == JSMN_ERROR_NOMEM);
+	free(mem.data);
+
+	/* Through a non-blocking pipe */
+	check(pipe(fds) == 0);
+	check(fcntl(fds[1], F_SETFL, O_NONBLOCK) == 0);
+	jsmn_init_emitter(&e);
+	jsmn_init_writer(&w, jsmn_sink_fd, &fds[1], block, sizeof(block), sizeof(block));
+	check(jsmn_emit_to(&p, js, sizeof(js), t, 32, &e, &w) == 0);
+	close(fds[1]);
+	n = read(fds[0], out, sizeof(out));
+	close(fds[0]);
+	check(n == (ssize_t) strlen(whole) && memcmp(out, whole, n) == 0);
+
+	return 0;
+}
 #endif
 
 int main(void) {
@@ -549,14 +2213,63 @@ int main(void) {
 	test(test_partial_string, "test partial JSON string parsing");
 	test(test_partial_array, "test partial array reading");
 	test(test_array_nomem, "test array reading with a smaller number of tokens");
+	test(test_parse_ex, "test array reading with growing tokens");
 	test(test_unquoted_keys, "test unquoted keys (like in JavaScript)");
 	test(test_input_length, "test strings that are not null-terminated");
 	test(test_issue_22, "test issue #22");
 	test(test_issue_27, "test issue #27");
 	test(test_count, "test tokens count estimation");
+#ifdef JSMN_SIMD
+	test(test_count_tokens, "test vectorized tokens count");
+#endif
 	test(test_nonstrict, "test for non-strict mode");
+	test(test_long_runs, "test tokens longer than a vector");
+	test(test_deep_nesting, "test deeply nested arrays");
+#ifdef JSMN_COMPACT
+	test(test_compact, "test compact tokens");
+#endif
+#ifdef JSMN_SKIP_LINKS
+	test(test_skip_links, "test skip links");
+#endif
+	test(test_keyset, "test perfect hash keysets");
+#ifndef JSMN_COMPACT
+	test(test_string_flags, "test string flags");
+	test(test_primitive_class, "test primitive classes");
+	test(test_container_flags, "test container flags");
+#endif
+#ifdef JSMN_DOM
+	test(test_dom_index, "test DOM name index");
+	test(test_dom_double, "test DOM double parsing");
+	test(test_dom_new_double, "test DOM double formatting");
+	test(test_dom_int64, "test DOM 64-bit integers");
+	test(test_dom_bulk, "test DOM bulk number arrays");
+	test(test_dom_unescape, "test DOM string unescaping");
+	test(test_dom_quote, "test DOM string quoting");
+	test(test_dom_cache, "test DOM token cache");
+	test(test_dom_dirty, "test DOM change tracking");
+#endif
+#ifdef JSMN_VALIDATE_UTF8
+	test(test_utf8, "test UTF-8 validation");
+#endif
+#ifdef JSMN_SAX
+	test(test_sax, "test SAX callbacks");
+#endif
+#ifdef JSMN_THREADS
+	test(test_parse_parallel, "test parsing on several threads");
+	test(test_parse_ndjson, "test NDJSON batches");
+#endif
+#ifdef JSMN_LARGE
+	test(test_large, "test offsets beyond 4 GiB");
+#endif
 #ifdef JSMN_EMITTER
 	test(test_emitter, "test emitter");
+	test(test_emit_chunks, "test emitter buffer sizes");
+#endif
+#ifdef JSMN_EMIT_IOV
+	test(test_emit_iov, "test emitter iovecs");
+#endif
+#ifdef JSMN_EMIT_SINKS
+	test(test_emit_sink, "test emitter sinks");
 #endif
 	printf("\nPASSED: %d\nFAILED: %d\n", test_passed, test_failed);
 	return (test_failed > 0);
@@ -29,19 +29,23 @@ static int vtokeq(const char *s, jsmntok_t *t, int numtok, va_list ap) {
 				size = va_arg(ap, int);
 				value = NULL;
 			}
-			if (t[i].type != type) {
-				printf("token %d type is %d, not %d\n", i, t[i].type, type);
+			if (JSMN_TOK_TYPE(&t[i]) != type) {
+				printf("token %d type is %d, not %d\n", i, JSMN_TOK_TYPE(&t[i]), type);
 				return 0;
 			}
 			if (start != -1 && end != -1) {
-				if (t[i].start != start) {
-					printf("token %d start is %d, not %d\n", i, t[i].start, start);
+				if (JSMN_TOK_START(&t[i]) != start) {
+					printf("token %d start is %d, not %d\n", i, (int) JSMN_TOK_START(&t[i]), start);
 					return 0;
 				}
+#ifdef JSMN_COMPACT
+				/* Compact objects and arrays do not record their end */
+#else
 				if (t[i].end != end ) {
-					printf("token %d end is %d, not %d\n", i, t[i].end, end);
+					printf("token %d end is %d, not %d\n", i, (int) t[i].end, end);
 					return 0;
 				}
+#endif
 			}
 #ifdef JSMN_DOM
 			if (size != -1) {
@@ -52,18 +56,18 @@ static int vtokeq(const char *s, jsmntok_t *t, int numtok, va_list ap) {
 				}
 			}
 #else
-			if (size != -1 && t[i].size != size) {
-				printf("token %d size is %d, not %d\n", i, t[i].size, size);
+			if (size != -1 && JSMN_TOK_SIZE(&t[i]) != size) {
+				printf("token %d size is %d, not %d\n", i, (int) JSMN_TOK_SIZE(&t[i]), size);
 				return 0;
 			}
 #endif
 
 			if (s != NULL && value != NULL) {
-				const char *p = s + t[i].start;
-				if (strlen(value) != t[i].end - t[i].start ||
-						strncmp(p, value, t[i].end - t[i].start) != 0) {
-					printf("token %d value is %.*s, not %s\n", i, t[i].end-t[i].start,
-							s+t[i].start, value);
+				const char *p = s + JSMN_TOK_START(&t[i]);
+				if (strlen(value) != JSMN_TOK_LEN(&t[i]) ||
+						strncmp(p, value, JSMN_TOK_LEN(&t[i])) != 0) {
+					printf("token %d value is %.*s, not %s\n", i, (int) JSMN_TOK_LEN(&t[i]),
+							s+JSMN_TOK_START(&t[i]), value);
 					return 0;
 				}
 			}